@@ -0,0 +1,117 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "http.h"
+#include "settings.h"
+
+// The clock's HTTP API on top of http.h: which handler a parsed request goes to (and
+// the error every other request gets), plus the /status and /config responses.
+// main.cpp serves it from WiFiServer, sim/http_host.cpp from a host socket where it
+// is checked by a local client. Include after config.h like settings.h.
+
+enum apiRoute {
+    API_ERROR,       // httpError() with the code and message from apiResolve()
+    API_STATUS,      // GET / or /status
+    API_CONFIG,      // GET /config
+    API_CONFIG_EDIT, // POST /config, the body is in the config buffer
+};
+
+// what /status reports, gathered by the caller; strings are not escaped
+struct apiStatus {
+    time_t utc;
+    const char* local; // formatClock()
+    const char* zone;
+    const char* source;
+    int32_t driftPpb;
+    const char* ntpServer;
+    uint32_t syncs;
+    int32_t lastSyncSecs; // -1 before the first sync
+    uint8_t ip[4];
+    int32_t rssi;
+    int32_t channel;
+    const char* radioSleep;
+    uint32_t listenInterval;
+    uint64_t radioOnSecs;
+    uint64_t radioOffSecs;
+    uint32_t wakes;
+    uint32_t wakeToSyncMs;
+    uint32_t maxWakeToSyncMs;
+    uint32_t heapFree;
+    uint32_t heapMinFree;
+    uint32_t heapMinMaxBlock;
+    uint32_t heapMaxFrag;
+    uint64_t uptimeSecs;
+};
+
+inline apiRoute apiResolve(httpParse result, const httpRequest& r, int* code, const char** message) {
+    bool get = strcmp(r.method, "GET") == 0;
+    bool status = strcmp(r.path, "/") == 0 || strcmp(r.path, "/status") == 0;
+    bool config = strcmp(r.path, "/config") == 0;
+
+    if (result == HTTP_PARSE_BAD) {
+        *code = 400;
+        *message = "bad request";
+    } else if (result == HTTP_PARSE_TOO_LARGE) {
+        *code = 413;
+        *message = "body too large";
+    } else if (status) {
+        if (get) {
+            return API_STATUS;
+        }
+        *code = 405;
+        *message = "use GET";
+    } else if (config) {
+        if (get || strcmp(r.method, "POST") == 0) {
+            return get ? API_CONFIG : API_CONFIG_EDIT;
+        }
+        *code = 405;
+        *message = "use GET or POST";
+    } else {
+        *code = 404;
+        *message = "not found";
+    }
+    return API_ERROR;
+}
+
+// formatConfig() of c through configBuffer, CONFIG_BUFFER_SIZE always fits PROFILE_MAX profiles
+template <class Out>
+void apiWriteConfig(Out& out, char* configBuffer, const configuration& c) {
+    int n = formatConfig(configBuffer, CONFIG_BUFFER_SIZE, c);
+    out.write((const uint8_t*) configBuffer, n > 0 ? n : 0);
+}
+
+template <class Out>
+void apiServeConfig(Out& out, char* buf, size_t size, char* configBuffer, const configuration& c) {
+    httpHeader(out, buf, size, 200, "application/json");
+    apiWriteConfig(out, configBuffer, c);
+    httpWrite(out, "\n");
+}
+
+// pieces are formatted one at a time into buf and written straight out; each fits
+// HTTP_BUFFER_SIZE with every number at full width, unbounded strings bypass it
+template <class Out>
+void apiServeStatus(Out& out, char* buf, size_t size, char* configBuffer, const apiStatus& s,
+    const configuration& c) {
+    httpHeader(out, buf, size, 200, "application/json");
+    httpPrintf(out, buf, size, "{\"time\":{\"utc\":%lld,\"local\":\"%s\",", (long long) s.utc, s.local);
+    httpPrintf(out, buf, size, "\"zone\":\"%s\",\"source\":\"%s\",\"driftPpb\":%d},",
+        s.zone, s.source, (int) s.driftPpb);
+    httpWrite(out, "\"ntp\":{\"server\":\"");
+    httpWrite(out, s.ntpServer);
+    httpPrintf(out, buf, size, "\",\"syncs\":%u,\"lastSyncSecs\":%d},", (unsigned) s.syncs, (int) s.lastSyncSecs);
+    httpPrintf(out, buf, size, "\"wifi\":{\"ip\":\"%u.%u.%u.%u\",\"rssi\":%d,\"channel\":%d},",
+        s.ip[0], s.ip[1], s.ip[2], s.ip[3], (int) s.rssi, (int) s.channel);
+    httpPrintf(out, buf, size, "\"radio\":{\"sleep\":\"%s\",\"listenInterval\":%u,\"onSecs\":%llu,\"offSecs\":%llu,",
+        s.radioSleep, (unsigned) s.listenInterval, (unsigned long long) s.radioOnSecs,
+        (unsigned long long) s.radioOffSecs);
+    httpPrintf(out, buf, size, "\"wakes\":%u,\"wakeToSyncMs\":%u,\"maxWakeToSyncMs\":%u},",
+        (unsigned) s.wakes, (unsigned) s.wakeToSyncMs, (unsigned) s.maxWakeToSyncMs);
+    httpPrintf(out, buf, size, "\"heap\":{\"free\":%u,\"minFree\":%u,\"minMaxBlock\":%u,\"maxFrag\":%u},",
+        (unsigned) s.heapFree, (unsigned) s.heapMinFree, (unsigned) s.heapMinMaxBlock, (unsigned) s.heapMaxFrag);
+    httpPrintf(out, buf, size, "\"uptimeSecs\":%llu,\"config\":", (unsigned long long) s.uptimeSecs);
+    apiWriteConfig(out, configBuffer, c);
+    httpWrite(out, "}\n");
+}
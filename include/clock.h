@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+// Software UTC clock: a (millis(), UTC) anchor plus the measured oscillator drift.
+// NTP replies re-anchor it and, once DRIFT_WINDOW_SECS apart, measure drift; between
+// syncs it free-runs on millis(). ms arguments are millis() values and wrap at 2^32.
+
+#define DRIFT_MAX_PPB 500000          // 500 ppm
+#define CLOCK_REANCHOR_MS 86400000UL  // daily, elapsed stays far from the 49.7 day wrap
+#define CLOCK_REF_MAX_MS 0x80000000UL // longer drift windows could span a millis() wrap
+
+enum timeSource {
+    TIME_SOURCE_NONE,  // clock never set
+    TIME_SOURCE_FLASH, // restored from file system, behind by power off duration
+    TIME_SOURCE_RTC,   // restored from RTC memory, survived reset
+    TIME_SOURCE_NTP,   // disciplined by NTP
+};
+
+struct clockState {
+    uint64_t anchorUtcMs; // UTC milliseconds at anchor
+    uint32_t anchorMs;    // millis() at anchor
+    uint64_t refUtcMs;    // drift measurement window start
+    uint32_t refMs;
+    int32_t driftPpb;     // oscillator drift, positive => millis() runs fast
+    timeSource source;
+    time_t prevUtc;
+    uint32_t fsSavedMs;
+    bool fsSaved;
+};
+
+inline int32_t clockClampPpb(int64_t ppb) {
+    return ppb < -DRIFT_MAX_PPB ? -DRIFT_MAX_PPB : ppb > DRIFT_MAX_PPB ? DRIFT_MAX_PPB : (int32_t) ppb;
+}
+
+// UTC milliseconds at millis() == ms, drift corrected
+inline uint64_t clockRead(const clockState& c, uint32_t ms) {
+    int64_t elapsed = (uint32_t) (ms - c.anchorMs);
+    elapsed -= elapsed * c.driftPpb / 1000000000LL;
+    return c.anchorUtcMs + elapsed;
+}
+
+// re-anchors on an NTP time, true when a new drift estimate was taken
+inline bool clockSync(clockState& c, uint64_t utcMs, uint32_t ms, uint32_t windowMs) {
+    bool measured = false;
+
+    if (c.source != TIME_SOURCE_NTP || utcMs - c.refUtcMs >= CLOCK_REF_MAX_MS) {
+        c.refUtcMs = utcMs;
+        c.refMs = ms;
+    } else if (utcMs - c.refUtcMs >= windowMs) {
+        int64_t actual = utcMs - c.refUtcMs;
+        int64_t local = (uint32_t) (ms - c.refMs);
+        int32_t ppb = clockClampPpb((local - actual) * 1000000000LL / actual);
+
+        c.driftPpb = c.driftPpb ? (c.driftPpb + ppb) / 2 : ppb;
+        c.refUtcMs = utcMs;
+        c.refMs = ms;
+        measured = true;
+    }
+    c.anchorUtcMs = utcMs;
+    c.anchorMs = ms;
+    c.source = TIME_SOURCE_NTP;
+    return measured;
+}
+
+// moves the anchor forward without NTP so millis() - anchorMs never wraps
+inline void clockReanchor(clockState& c, uint64_t utcMs, uint32_t ms) {
+    if ((uint32_t) (ms - c.anchorMs) >= CLOCK_REANCHOR_MS) {
+        c.anchorUtcMs = utcMs;
+        c.anchorMs = ms;
+    }
+}
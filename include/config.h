@@ -2,9 +2,20 @@
 
 #include "secrets.h"
 
+// features, 0 removes the code and data from the build (see `make size`)
+#define FEATURE_YEAR_PAGE 1
+#define FEATURE_LIFE_PAGE 1    // includes birth/death settings pages
+#define FEATURE_HOURGLASS 1    // animation on year/life pages
+#define FEATURE_ARDUINOJSON 1  // 0 = minimal built-in config reader
+#define FEATURE_FLOAT_PRINTF 1 // 0 = fixed point page math, the core's printf still links float support
+#define FEATURE_SNTP_SERVER 0  // serve time to other units on the LAN once synced upstream
+#define FEATURE_HTTP 1         // status and config over HTTP, see README
+
+#define DISPLAY_SSD1306 1
+#define DISPLAY_SH1106 2
+#define DISPLAY_CONTROLLER DISPLAY_SSD1306
 #define DISPLAY_WIDTH 128
-#define DISPLAY_HEIGHT 64
-#define DISPLAY_RESET -1 // share Arduino reset pin
+#define DISPLAY_HEIGHT 64 // 64 or 32
 #define DISPLAY_I2C_ADDR 0x3c
 #define DISPLAY_SDA D2
 #define DISPLAY_SCL D1
@@ -17,12 +28,40 @@
 #define DEBOUNCE_MS 250          // default debounce input
 #define DISPLAY_INTERVAL_MS 1000 // update time display once a second
 
+#define WIFI_FAST_TIMEOUT_MS 2000 // cached BSSID/channel attempt before full scan
+// optional static IP, skips DHCP when defined
+// #define WIFI_STATIC_IP  192, 168, 1, 50
+// #define WIFI_GATEWAY    192, 168, 1, 1
+// #define WIFI_SUBNET     255, 255, 255, 0
+// #define WIFI_DNS        192, 168, 1, 1
+
+#define RADIO_SLEEP_NONE 0   // always listening, lowest HTTP/SNTP latency
+#define RADIO_SLEEP_MODEM 1  // stays associated, radio dozes between AP beacons
+#define RADIO_SLEEP_FORCED 2 // radio off between NTP syncs, needs FEATURE_HTTP and FEATURE_SNTP_SERVER 0
+#define RADIO_SLEEP RADIO_SLEEP_MODEM
+#define RADIO_LISTEN_INTERVAL 3  // modem: wake for every 3rd DTIM beacon (1..10), 0 = AP's DTIM, higher adds HTTP/SNTP latency
+#define RADIO_WAKE_LEAD_MS 3000  // forced: first reconnect estimate, then measured
+#define RADIO_MIN_SLEEP_SECS 30  // forced: shorter gaps (e.g. NTP retries) keep the radio on
+
 #define UDP_PORT 8888
+#define HTTP_PORT 80
 #define NTP_WAIT_MS 3000
+#define NTP_DNS_TIMEOUT_MS 2000 // loop() stalls at most this long, only after a failed sync
 #define NTP_SYNC_SECS 300
-const char* ntpServer = "time.nist.gov";
+#define NTP_RETRY_SECS 15
+const char* ntpServer = "time.nist.gov"; // or the IP of a unit running the SNTP server
+#define SNTP_MAX_AGE_SECS (4 * NTP_SYNC_SECS) // flag clients unsynced past this
+
+#define DRIFT_WINDOW_SECS 3600   // min NTP interval to measure oscillator drift over
+#define TIME_FS_SAVE_SECS 3600   // persist time anchor to flash hourly, limits wear
+const char* timePath = "/time.bin";
 
 const char* configPath = "/config.json";
-#define UTC_OFFSET_DEFAULT -5.0f // ETC
+#define UTC_OFFSET_DEFAULT -5.0f // ETC, used when TZ rule is empty or invalid
+#define TZ_DEFAULT "EST5EDT,M3.2.0,M11.1.0" // POSIX TZ, DST handled without resync
 #define BIRTH_DEFAULT  820515600 // 1996-01-01 12:00:00
 #define DEATH_DEFAULT 3345123600 // 2076-01-01 12:00:00
+#define PROFILE_NAME_DEFAULT "Life" // profile made from birth/death above or in an old config
+#define PROFILE_MAX 4               // countdowns rotated through on the life page
+#define PROFILE_NAME_SIZE 12        // 11 chars + " Remaining" fits one 128px line
+#define PROFILE_ROTATE_SECS 10      // 0 = switch only on encoder press
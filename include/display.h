@@ -0,0 +1,79 @@
+#pragma once
+
+#include <Adafruit_GFX.h>
+#include <Wire.h>
+
+#include "panel.h"
+
+#define WIRE_CHUNK 31 // payload per I2C transaction, + control byte fits a 32 byte Wire buffer
+
+// I2C transport for panel<>, control byte 0x00 = command stream, 0x40 = data stream
+template <uint8_t ADDR>
+struct wireBus {
+    bool begin() {
+        Wire.beginTransmission(ADDR);
+        return Wire.endTransmission() == 0;
+    }
+
+    void commands(const uint8_t* cmds, size_t size) {
+        send(0x00, cmds, size);
+    }
+
+    void data(const uint8_t* bytes, size_t size) {
+        send(0x40, bytes, size);
+    }
+
+  private:
+    static void send(uint8_t control, const uint8_t* p, size_t size) {
+        while (size > 0) {
+            size_t n = size < WIRE_CHUNK ? size : WIRE_CHUNK;
+
+            Wire.beginTransmission(ADDR);
+            Wire.write(control);
+            Wire.write(p, n);
+            Wire.endTransmission();
+            p += n;
+            size -= n;
+        }
+    }
+};
+
+// Adafruit GFX text/bitmap drawing on top of a compile-time panel. Pixel and line
+// primitives go straight to the page-major buffer; final lets calls through the
+// concrete type devirtualize. Rotation 0 only.
+template <class Controller, uint8_t W, uint8_t H, uint8_t ADDR>
+class oledDisplay final : public Adafruit_GFX {
+  public:
+    oledDisplay() : Adafruit_GFX(W, H) {}
+
+    bool begin() {
+        return oled.begin();
+    }
+
+    void clearDisplay() {
+        oled.clear();
+    }
+
+    void display() {
+        oled.flush();
+    }
+
+    void drawPixel(int16_t x, int16_t y, uint16_t color) override {
+        oled.setPixel(x, y, color);
+    }
+
+    void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) override {
+        oled.hline(x, y, w, color);
+    }
+
+    void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) override {
+        oled.vline(x, y, h, color);
+    }
+
+    void fillScreen(uint16_t color) override {
+        oled.fill(color);
+    }
+
+  private:
+    panel<Controller, wireBus<ADDR>, W, H> oled;
+};
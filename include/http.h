@@ -0,0 +1,156 @@
+#pragma once
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+// Minimal HTTP/1.0 server side: an incremental request parser fed whatever bytes
+// arrived this loop() pass, and helpers that stream a response through any Out with
+// write(const uint8_t*, size_t) and a caller-owned fixed buffer. Only the request
+// line and Content-Length are kept, other headers are skipped as they stream by.
+
+#define HTTP_LINE_SIZE 96       // longer header lines are cut, the request line must fit
+#define HTTP_METHOD_SIZE 8
+#define HTTP_PATH_SIZE 32
+#define HTTP_BYTES_PER_TICK 256 // bounds parsing work per loop()
+#define HTTP_TIMEOUT_MS 2000    // whole request, a stalled client is dropped
+#define HTTP_BUFFER_SIZE 128    // one formatted piece of a response
+
+enum httpParse {
+    HTTP_PARSE_MORE,      // need more bytes
+    HTTP_PARSE_DONE,      // request line, headers and body complete
+    HTTP_PARSE_BAD,       // malformed request line, 400
+    HTTP_PARSE_TOO_LARGE, // body does not fit, 413
+};
+
+enum httpStage {
+    HTTP_STAGE_REQUEST_LINE,
+    HTTP_STAGE_HEADERS,
+    HTTP_STAGE_BODY,
+};
+
+struct httpRequest {
+    httpStage stage;
+    char line[HTTP_LINE_SIZE];
+    uint8_t lineLen;
+    char method[HTTP_METHOD_SIZE];
+    char path[HTTP_PATH_SIZE]; // query string dropped
+    size_t contentLength;
+    size_t bodyLen;
+};
+
+inline void httpBegin(httpRequest& r) {
+    memset(&r, 0, sizeof(r));
+}
+
+// "METHOD /path[?query] HTTP/1.x"
+inline bool httpParseRequestLine(httpRequest& r) {
+    const char* path = strchr(r.line, ' ');
+
+    if (!path || path == r.line || path - r.line >= HTTP_METHOD_SIZE || path[1] != '/') {
+        return false;
+    }
+    const char* end = strchr(++path, ' ');
+    size_t n = end ? strcspn(path, " ?") : 0;
+
+    if (!end || n >= HTTP_PATH_SIZE) {
+        return false;
+    }
+    memcpy(r.method, r.line, path - 1 - r.line);
+    memcpy(r.path, path, n);
+    return true;
+}
+
+inline bool httpIsHeader(const char* line, const char* name) {
+    size_t n = strlen(name);
+    return strncasecmp(line, name, n) == 0 && line[n] == ':';
+}
+
+// one byte at a time, the body goes to body[0, bodySize - 1) and is NUL terminated
+inline httpParse httpFeed(httpRequest& r, char c, char* body, size_t bodySize) {
+    if (r.stage == HTTP_STAGE_BODY) {
+        body[r.bodyLen++] = c;
+
+        if (r.bodyLen < r.contentLength) {
+            return HTTP_PARSE_MORE;
+        }
+        body[r.bodyLen] = '\0';
+        return HTTP_PARSE_DONE;
+    }
+    if (c != '\n') {
+        if (c != '\r' && r.lineLen < HTTP_LINE_SIZE - 1) {
+            r.line[r.lineLen++] = c;
+        }
+        return HTTP_PARSE_MORE;
+    }
+    r.line[r.lineLen] = '\0';
+    r.lineLen = 0;
+
+    if (r.stage == HTTP_STAGE_REQUEST_LINE) {
+        r.stage = HTTP_STAGE_HEADERS;
+        return httpParseRequestLine(r) ? HTTP_PARSE_MORE : HTTP_PARSE_BAD;
+    }
+    if (r.line[0] != '\0') {
+        if (httpIsHeader(r.line, "Content-Length")) {
+            r.contentLength = strtoul(r.line + 15, nullptr, 10);
+        }
+        return HTTP_PARSE_MORE;
+    }
+    // blank line ends the headers
+    if (r.contentLength >= bodySize) {
+        return HTTP_PARSE_TOO_LARGE;
+    }
+    body[0] = '\0';
+    r.stage = HTTP_STAGE_BODY;
+    return r.contentLength ? HTTP_PARSE_MORE : HTTP_PARSE_DONE;
+}
+
+inline const char* httpReason(int code) {
+    switch (code) {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 408: return "Request Timeout";
+        case 413: return "Payload Too Large";
+        default: return "Error";
+    }
+}
+
+template <class Out>
+void httpWrite(Out& out, const char* s) {
+    out.write((const uint8_t*) s, strlen(s));
+}
+
+// formatted through buf, output longer than size - 1 is cut
+template <class Out>
+void httpPrintf(Out& out, char* buf, size_t size, const char* format, ...) __attribute__((format(printf, 4, 5)));
+
+template <class Out>
+void httpPrintf(Out& out, char* buf, size_t size, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(buf, size, format, args);
+    va_end(args);
+
+    if (n > 0) {
+        out.write((const uint8_t*) buf, (size_t) n < size ? (size_t) n : size - 1);
+    }
+}
+
+// HTTP/1.0 status line and headers, the body runs until the connection closes
+template <class Out>
+void httpHeader(Out& out, char* buf, size_t size, int code, const char* contentType) {
+    httpPrintf(out, buf, size, "HTTP/1.0 %d %s\r\nContent-Type: %s\r\nCache-Control: no-store\r\n"
+        "Connection: close\r\n\r\n", code, httpReason(code), contentType);
+}
+
+template <class Out>
+void httpError(Out& out, char* buf, size_t size, int code, const char* message) {
+    httpHeader(out, buf, size, code, "application/json");
+    httpPrintf(out, buf, size, "{\"error\":\"%s\"}\n", message);
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "tz.h"
+
+// Page math and text: the per-second time frame, countdowns, remaining percent/hours,
+// dates and calendar steps of the date editor. Shared by main.cpp and the simulator
+// in sim/, so include after config.h for the FEATURE_* and PROFILE_MAX it reads.
+
+#define PAGE_SECS_PER_HOUR 3600
+#define DISPLAY_BUFFER_SIZE 32 // one line of page text, fits every format*() below
+
+// start/end plus what the pages derive from them, see updateCountdown()
+struct countdown {
+    time_t start;
+    time_t end;
+    time_t total;
+#if FEATURE_FLOAT_PRINTF
+    double percentScale; // 100 / total, frames multiply instead of divide
+#endif
+};
+
+// one view of the time per second, built by frameUpdate() and read by every page and
+// format routine so a frame never mixes two seconds
+struct timeFrame {
+    time_t utc;
+    time_t local;
+    int32_t year;
+    uint8_t month;
+    uint8_t day;
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t second;
+#if FEATURE_YEAR_PAGE
+    countdown yearSpan; // recomputed on new year only
+    time_t yearRemaining;
+#endif
+#if FEATURE_LIFE_PAGE
+    time_t remaining[PROFILE_MAX]; // per profile, filled by the caller
+#endif
+};
+
+// derived values once per edit/new year, pages only subtract and multiply
+inline void updateCountdown(countdown& c) {
+    c.total = c.end - c.start > 1 ? c.end - c.start : 1;
+#if FEATURE_FLOAT_PRINTF
+    c.percentScale = 100.0 / c.total;
+#endif
+}
+
+inline void frameUpdate(timeFrame& f, tzInfo& zone, time_t utc) {
+    f.utc = utc;
+    f.local = tzLocal(zone, utc);
+    tzDate(f.local, &f.year, &f.month, &f.day);
+    tzClock(f.local, &f.hour, &f.minute, &f.second);
+#if FEATURE_YEAR_PAGE
+    if (f.local < f.yearSpan.start || f.local >= f.yearSpan.end) {
+        f.yearSpan.start = tzYearStart(f.year);
+        f.yearSpan.end = tzYearStart(f.year + 1);
+        updateCountdown(f.yearSpan);
+    }
+    f.yearRemaining = f.yearSpan.end - f.local;
+#endif
+}
+
+// num/den with fixed decimals by long division, avoids double math and float printf
+inline char* formatRatio(char* buffer, int64_t num, int64_t den, uint8_t decimals) {
+    char* p = buffer;
+
+    if ((num < 0) != (den < 0) && num != 0) {
+        *p++ = '-';
+    }
+    uint64_t n = num < 0 ? -num : num;
+    uint64_t d = den < 0 ? -den : den;
+
+    p += sprintf(p, "%llu", (unsigned long long) (n / d));
+    if (decimals) {
+        *p++ = '.';
+    }
+    for (uint64_t r = n % d; decimals > 0; decimals--) {
+        r *= 10;
+        *p++ = '0' + r / d;
+        r %= d;
+    }
+    *p = '\0';
+    return p;
+}
+
+// YYYY-MM-DD hh:mm:ss
+inline void formatClock(char* buffer, size_t size, const timeFrame& f) {
+    snprintf(buffer, size, "%04d-%02d-%02d %02d:%02d:%02d", (int) f.year, f.month, f.day, f.hour, f.minute, f.second);
+}
+
+// YYYY-MM-DD
+inline void formatDate(char* buffer, size_t size, time_t t) {
+    int32_t y;
+    uint8_t m, d;
+    tzDate(t, &y, &m, &d);
+    snprintf(buffer, size, "%04d-%02d-%02d", (int) y, m, d);
+}
+
+// percent of c left, 10 decimals; buffer holds at least DISPLAY_BUFFER_SIZE chars
+inline void formatPercentLeft(char* buffer, size_t size, const countdown& c, time_t remaining) {
+#if FEATURE_FLOAT_PRINTF
+    snprintf(buffer, size, "%02.10lf %%", remaining * c.percentScale);
+#else
+    char* end = formatRatio(buffer, (int64_t) remaining * 100, c.total, 10);
+    snprintf(end, size - (end - buffer), " %%");
+#endif
+}
+
+// hours left, 6 decimals
+inline void formatHoursLeft(char* buffer, size_t size, time_t remaining) {
+#if FEATURE_FLOAT_PRINTF
+    snprintf(buffer, size, "%.6lf h", remaining * (1.0 / PAGE_SECS_PER_HOUR));
+#else
+    char* end = formatRatio(buffer, remaining, PAGE_SECS_PER_HOUR, 6);
+    snprintf(end, size - (end - buffer), " h");
+#endif
+}
+
+// date editor step of field 0=year, 1=month, 2=day; calendar steps keep the time of
+// day and clamp the day to the month (Jan 31 + 1 month = Feb 28/29)
+inline time_t stepDate(time_t t, uint8_t field, int8_t dir) {
+    if (field == 2) {
+        return t + (time_t) TZ_SECS_PER_DAY * dir;
+    }
+    int32_t y;
+    uint8_t m, d;
+    tzDate(t, &y, &m, &d);
+    time_t secs = t - (time_t) tzDaysOf(t) * TZ_SECS_PER_DAY;
+    int32_t months = y * 12 + (m - 1) + (field == 0 ? 12 * dir : dir);
+
+    y = months / 12;
+    m = months % 12 + 1;
+    d = d < tzDaysInMonth(y, m) ? d : tzDaysInMonth(y, m);
+    return (time_t) tzDaysFromCivil(y, m, d) * TZ_SECS_PER_DAY + secs;
+}
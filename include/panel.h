@@ -0,0 +1,208 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Monochrome OLED panels as compile-time types: panel<Controller, Bus, W, H>.
+// Framebuffer is page-major like the controllers' GDDRAM (byte = 8 vertical pixels,
+// bit 0 on top), so flush is a straight copy. Controllers are static policies and the
+// bus is a template parameter, nothing is dispatched at runtime. See panel_mock.h for
+// host stand-ins of the buses.
+
+#ifndef WHITE
+#define BLACK 0
+#define WHITE 1
+#define INVERSE 2
+#endif
+
+#define PANEL_PAGE_BITS 8
+
+// SSD1306: horizontal addressing, whole frame in one data stream
+// https://cdn-shop.adafruit.com/datasheets/SSD1306.pdf
+struct ssd1306 {
+    static const uint8_t COLUMN_OFFSET = 0;
+
+    template <uint8_t W, uint8_t H, class Bus>
+    static void init(Bus& bus) {
+        const uint8_t cmds[] = {
+            0xAE,                           // display off
+            0xD5, 0x80,                     // clock divide
+            0xA8, H - 1,                    // multiplex
+            0xD3, 0x00,                     // display offset
+            0x40,                           // start line 0
+            0x8D, 0x14,                     // charge pump on (internal VCC)
+            0x20, 0x00,                     // horizontal addressing
+            0xA1,                           // segment remap
+            0xC8,                           // COM scan descending
+            0xDA, H == 64 ? 0x12 : 0x02,    // COM pins
+            0x81, H == 64 ? 0xCF : 0x8F,    // contrast
+            0xD9, 0xF1,                     // pre-charge
+            0xDB, 0x40,                     // VCOMH deselect
+            0xA4,                           // resume from RAM
+            0xA6,                           // normal, not inverted
+            0x2E,                           // scroll off
+            0xAF,                           // display on
+        };
+        bus.commands(cmds, sizeof(cmds));
+    }
+
+    template <uint8_t W, uint8_t H, class Bus>
+    static void flush(Bus& bus, const uint8_t* buffer) {
+        const uint8_t cmds[] = {
+            0x22, 0, H / PANEL_PAGE_BITS - 1, // page range
+            0x21, 0, W - 1,                   // column range
+        };
+        bus.commands(cmds, sizeof(cmds));
+        bus.data(buffer, W * (H / PANEL_PAGE_BITS));
+    }
+};
+
+// SH1106: 132 column RAM with the glass at column 2, page addressing only
+// https://www.velleman.eu/downloads/29/infosheets/sh1106_datasheet.pdf
+struct sh1106 {
+    static const uint8_t COLUMN_OFFSET = 2;
+
+    template <uint8_t W, uint8_t H, class Bus>
+    static void init(Bus& bus) {
+        const uint8_t cmds[] = {
+            0xAE,                        // display off
+            0xD5, 0x80,                  // clock divide
+            0xA8, H - 1,                 // multiplex
+            0xD3, 0x00,                  // display offset
+            0x40,                        // start line 0
+            0xAD, 0x8B,                  // DC-DC on
+            0xA1,                        // segment remap
+            0xC8,                        // COM scan descending
+            0xDA, H == 64 ? 0x12 : 0x02, // COM pins
+            0x81, 0xFF,                  // contrast
+            0xD9, 0x1F,                  // pre-charge
+            0xDB, 0x40,                  // VCOM deselect
+            0x33,                        // pump 9V
+            0xA6,                        // normal, not inverted
+            0xA4,                        // resume from RAM
+            0xAF,                        // display on
+        };
+        bus.commands(cmds, sizeof(cmds));
+    }
+
+    template <uint8_t W, uint8_t H, class Bus>
+    static void flush(Bus& bus, const uint8_t* buffer) {
+        for (uint8_t page = 0; page < H / PANEL_PAGE_BITS; page++) {
+            const uint8_t cmds[] = {
+                (uint8_t) (0xB0 | page),                  // page
+                (uint8_t) (0x00 | (COLUMN_OFFSET & 0x0F)), // column low nibble
+                (uint8_t) (0x10 | (COLUMN_OFFSET >> 4)),   // column high nibble
+            };
+            bus.commands(cmds, sizeof(cmds));
+            bus.data(buffer + page * W, W);
+        }
+    }
+};
+
+template <class Controller, class Bus, uint8_t W, uint8_t H>
+class panel {
+  public:
+    static_assert(H % PANEL_PAGE_BITS == 0, "panel height must be a multiple of 8");
+
+    static const uint8_t WIDTH = W;
+    static const uint8_t HEIGHT = H;
+    static const uint16_t BUFFER_SIZE = W * (H / PANEL_PAGE_BITS);
+
+    Bus bus;
+    uint8_t buffer[BUFFER_SIZE];
+
+    bool begin() {
+        if (!bus.begin()) {
+            return false;
+        }
+        clear();
+        Controller::template init<W, H>(bus);
+        return true;
+    }
+
+    void clear() {
+        memset(buffer, 0, BUFFER_SIZE);
+    }
+
+    void flush() {
+        Controller::template flush<W, H>(bus, buffer);
+    }
+
+    inline void setPixel(int16_t x, int16_t y, uint16_t color) {
+        if (x < 0 || x >= W || y < 0 || y >= H) {
+            return;
+        }
+        uint8_t* b = &buffer[(y / PANEL_PAGE_BITS) * W + x];
+        uint8_t mask = 1 << (y & (PANEL_PAGE_BITS - 1));
+        apply(b, mask, color);
+    }
+
+    // horizontal run within one page row, one mask for all bytes
+    void hline(int16_t x, int16_t y, int16_t w, uint16_t color) {
+        if (y < 0 || y >= H || w <= 0) {
+            return;
+        }
+        if (x < 0) {
+            w += x;
+            x = 0;
+        }
+        if (x + w > W) {
+            w = W - x;
+        }
+        uint8_t* b = &buffer[(y / PANEL_PAGE_BITS) * W + x];
+        uint8_t mask = 1 << (y & (PANEL_PAGE_BITS - 1));
+
+        for (; w > 0; w--) {
+            apply(b++, mask, color);
+        }
+    }
+
+    // vertical run, whole bytes for the pages it fully covers
+    void vline(int16_t x, int16_t y, int16_t h, uint16_t color) {
+        if (x < 0 || x >= W || h <= 0) {
+            return;
+        }
+        if (y < 0) {
+            h += y;
+            y = 0;
+        }
+        if (y + h > H) {
+            h = H - y;
+        }
+        while (h > 0) {
+            uint8_t bit = y & (PANEL_PAGE_BITS - 1);
+            uint8_t n = (h < PANEL_PAGE_BITS - bit) ? h : PANEL_PAGE_BITS - bit;
+            uint8_t mask = (uint8_t) (0xFF << bit) & (0xFF >> (PANEL_PAGE_BITS - bit - n));
+
+            apply(&buffer[(y / PANEL_PAGE_BITS) * W + x], mask, color);
+            y += n;
+            h -= n;
+        }
+    }
+
+    void fill(uint16_t color) {
+        if (color == INVERSE) {
+            for (uint16_t i = 0; i < BUFFER_SIZE; i++) {
+                buffer[i] ^= 0xFF;
+            }
+        } else {
+            memset(buffer, color == WHITE ? 0xFF : 0x00, BUFFER_SIZE);
+        }
+    }
+
+  private:
+    static inline void apply(uint8_t* b, uint8_t mask, uint16_t color) {
+        switch (color) {
+            case WHITE:
+                *b |= mask;
+                break;
+            case BLACK:
+                *b &= ~mask;
+                break;
+            case INVERSE:
+                *b ^= mask;
+                break;
+        }
+    }
+};
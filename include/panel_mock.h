@@ -0,0 +1,147 @@
+#pragma once
+
+#include "panel.h"
+
+// Host stand-ins for the panel bus, one per controller. Each decodes the command
+// stream the way the chip does and writes data into an emulated GDDRAM, so a
+// panel<ssd1306, ssd1306Mock, ...> can be rendered and compared without hardware:
+//
+//   panel<sh1106, sh1106Mock, 128, 64> p;
+//   p.begin(); p.hline(0, 0, 10, WHITE); p.flush();
+//   p.bus.pixel(2, 0) == true // SH1106 glass starts at RAM column 2
+
+struct mockBusStats {
+    uint32_t transfers;
+    uint32_t commandBytes;
+    uint32_t dataBytes;
+};
+
+// arguments following a command byte, 0 for single byte commands
+inline uint8_t ssd1306ArgCount(uint8_t cmd) {
+    switch (cmd) {
+        case 0x21: case 0x22:
+            return 2;
+        case 0x20: case 0x81: case 0x8D: case 0xA8: case 0xD3:
+        case 0xD5: case 0xD9: case 0xDA: case 0xDB:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+inline uint8_t sh1106ArgCount(uint8_t cmd) {
+    switch (cmd) {
+        case 0x81: case 0xA8: case 0xAD: case 0xD3:
+        case 0xD5: case 0xD9: case 0xDA: case 0xDB:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// 128 column RAM, horizontal addressing within the column/page window
+struct ssd1306Mock {
+    static const uint8_t COLUMNS = 128;
+    static const uint8_t PAGES = 8;
+    static const uint8_t GLASS_OFFSET = 0; // RAM column of the first glass column
+
+    uint8_t ram[PAGES][COLUMNS];
+    uint8_t colStart, colEnd, pageStart, pageEnd;
+    uint8_t col, page;
+    bool on;
+    mockBusStats stats;
+
+    bool begin() {
+        memset(this, 0, sizeof(*this));
+        colEnd = COLUMNS - 1;
+        pageEnd = PAGES - 1;
+        return true;
+    }
+
+    void commands(const uint8_t* cmds, size_t size) {
+        stats.transfers++;
+        stats.commandBytes += size;
+
+        for (size_t i = 0; i < size; i += 1 + ssd1306ArgCount(cmds[i])) {
+            if (cmds[i] == 0x21 && i + 2 < size) {
+                colStart = col = cmds[i + 1] % COLUMNS;
+                colEnd = cmds[i + 2] % COLUMNS;
+            } else if (cmds[i] == 0x22 && i + 2 < size) {
+                pageStart = page = cmds[i + 1] % PAGES;
+                pageEnd = cmds[i + 2] % PAGES;
+            } else if (cmds[i] == 0xAE || cmds[i] == 0xAF) {
+                on = cmds[i] == 0xAF;
+            }
+        }
+    }
+
+    void data(const uint8_t* bytes, size_t size) {
+        stats.transfers++;
+        stats.dataBytes += size;
+
+        for (size_t i = 0; i < size; i++) {
+            ram[page][col] = bytes[i];
+
+            if (col++ == colEnd) {
+                col = colStart;
+                page = (page == pageEnd) ? pageStart : page + 1;
+            }
+        }
+    }
+
+    bool pixel(uint8_t x, uint8_t y) const {
+        return ram[y / PANEL_PAGE_BITS][x + GLASS_OFFSET] & (1 << (y % PANEL_PAGE_BITS));
+    }
+};
+
+// 132 column RAM, page addressing, column pointer stops at the last column
+struct sh1106Mock {
+    static const uint8_t COLUMNS = 132;
+    static const uint8_t PAGES = 8;
+    static const uint8_t GLASS_OFFSET = 2; // from the datasheet, not sh1106::COLUMN_OFFSET
+
+    uint8_t ram[PAGES][COLUMNS];
+    uint8_t col, page;
+    bool on;
+    mockBusStats stats;
+
+    bool begin() {
+        memset(this, 0, sizeof(*this));
+        return true;
+    }
+
+    void commands(const uint8_t* cmds, size_t size) {
+        stats.transfers++;
+        stats.commandBytes += size;
+
+        for (size_t i = 0; i < size; i += 1 + sh1106ArgCount(cmds[i])) {
+            uint8_t c = cmds[i];
+
+            if ((c & 0xF0) == 0xB0) {
+                page = (c & 0x0F) % PAGES;
+            } else if ((c & 0xF0) == 0x00) {
+                col = (col & 0xF0) | (c & 0x0F);
+            } else if ((c & 0xF0) == 0x10) {
+                col = (col & 0x0F) | ((c & 0x0F) << 4);
+            } else if (c == 0xAE || c == 0xAF) {
+                on = c == 0xAF;
+            }
+        }
+    }
+
+    void data(const uint8_t* bytes, size_t size) {
+        stats.transfers++;
+        stats.dataBytes += size;
+
+        for (size_t i = 0; i < size; i++) {
+            if (col < COLUMNS) {
+                ram[page][col++] = bytes[i];
+            }
+        }
+    }
+
+    // x in glass coordinates
+    bool pixel(uint8_t x, uint8_t y) const {
+        return ram[y / PANEL_PAGE_BITS][x + GLASS_OFFSET] & (1 << (y % PANEL_PAGE_BITS));
+    }
+};
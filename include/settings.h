@@ -0,0 +1,273 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pages.h"
+#include "tz.h"
+
+// Config model shared by main.cpp and the HTTP harness in sim/: what a JSON body
+// holds, how it merges over the current config, validation and the JSON written
+// back. Include after config.h for the PROFILE_* and FEATURE_* it reads.
+
+#define UTC_MIN -12.0f
+#define UTC_MAX 14.0f
+#define CONFIG_BUFFER_SIZE 512 // file and HTTP body, fits PROFILE_MAX profiles
+
+struct profile {
+    char name[PROFILE_NAME_SIZE];
+    countdown span;
+};
+
+struct configuration {
+    float utcOffset; // fixed offset, used when tz is empty
+    char tz[TZ_SPEC_SIZE];
+    profile profiles[PROFILE_MAX];
+    uint8_t profileCount;
+};
+
+// keys found in a config body, filled by either JSON reader and applied by mergeConfig()
+struct configInput {
+    bool hasUtc;
+    bool hasTz;
+    bool hasProfiles;
+    bool hasBirth; // single birth/death pair of older configs
+    bool hasDeath;
+    float utc;
+    char tz[TZ_SPEC_SIZE];
+    profile profiles[PROFILE_MAX];
+    uint8_t profileCount;
+    time_t birth;
+    time_t death;
+};
+
+inline void setProfile(profile& p, const char* name, time_t start, time_t end) {
+    if (name != p.name) {
+        snprintf(p.name, sizeof(p.name), "%s", name);
+    }
+    p.span.start = start;
+    p.span.end = end;
+    updateCountdown(p.span);
+}
+
+// closing quote of the string opening at p, nullptr when unterminated
+inline const char* jsonStringEnd(const char* p) {
+    for (p++; *p && *p != '"'; p++) {
+        if (*p == '\\' && p[1]) {
+            p++;
+        }
+    }
+    return *p ? p : nullptr;
+}
+
+// bracket closing the object/array opening at p, strings skipped; nullptr when unterminated
+inline const char* jsonEnd(const char* p) {
+    int depth = 0;
+
+    for (; *p; p++) {
+        if (*p == '"' && !(p = jsonStringEnd(p))) {
+            return nullptr;
+        } else if (*p == '{' || *p == '[') {
+            depth++;
+        } else if ((*p == '}' || *p == ']') && --depth == 0) {
+            return p;
+        }
+    }
+    return nullptr;
+}
+
+// value of "key" among the members of the object opening at json; only a string in
+// key position (followed by ':') at the top level counts, never values or nested keys
+inline const char* jsonFind(const char* json, const char* key) {
+    size_t n = strlen(key);
+    int depth = 0;
+
+    for (const char* p = json; *p; p++) {
+        if (*p == '"') {
+            const char* end = jsonStringEnd(p);
+            const char* v = end;
+
+            if (!end) {
+                return nullptr;
+            }
+            for (v++; *v == ' ' || *v == '\t' || *v == '\r' || *v == '\n'; v++) {}
+
+            if (depth == 1 && *v == ':' && (size_t) (end - p - 1) == n && strncmp(p + 1, key, n) == 0) {
+                for (v++; *v == ' ' || *v == '\t' || *v == '\r' || *v == '\n'; v++) {}
+                return v;
+            }
+            p = end;
+        } else if (*p == '{' || *p == '[') {
+            depth++;
+        } else if (*p == '}' || *p == ']') {
+            depth--;
+        }
+    }
+    return nullptr;
+}
+
+inline time_t jsonTime(const char* json, const char* key) {
+    const char* v = jsonFind(json, key);
+    return v ? strtoll(v, nullptr, 10) : 0;
+}
+
+inline void jsonString(const char* value, char* out, size_t size) {
+    size_t n = 0;
+
+    if (value && *value++ == '"') {
+        for (; *value && *value != '"' && n < size - 1; value++) {
+            out[n++] = *value;
+        }
+    }
+    out[n] = '\0';
+}
+
+// minimal reader, profile objects are cut out of json in place; -1 when not an object
+// or the profiles are malformed
+inline int readConfig(char* json, configInput& in) {
+    const char* v;
+    memset(&in, 0, sizeof(in));
+
+    if (json[0] != '{') {
+        return -1;
+    }
+    if ((v = jsonFind(json, "utc"))) {
+        in.hasUtc = true;
+        in.utc = strtod(v, nullptr);
+    }
+    if ((v = jsonFind(json, "tz"))) {
+        in.hasTz = true;
+        jsonString(v, in.tz, sizeof(in.tz));
+    }
+    if ((v = jsonFind(json, "birth"))) {
+        in.hasBirth = true;
+        in.birth = strtoll(v, nullptr, 10);
+    }
+    if ((v = jsonFind(json, "death"))) {
+        in.hasDeath = true;
+        in.death = strtoll(v, nullptr, 10);
+    }
+    char* p = (char*) jsonFind(json, "profiles");
+    in.hasProfiles = p != nullptr;
+
+    if (p && *p++ != '[') {
+        return -1;
+    }
+    // root keys are all read, so each object can be cut out in place for its lookups
+    while (p && in.profileCount < PROFILE_MAX && (p += strspn(p, " \t\r\n,")) && *p == '{') {
+        char* end = (char*) jsonEnd(p);
+        char name[PROFILE_NAME_SIZE];
+
+        if (!end) {
+            return -1;
+        }
+        *end = '\0';
+        jsonString(jsonFind(p, "name"), name, sizeof(name));
+        setProfile(in.profiles[in.profileCount++], name, jsonTime(p, "start"), jsonTime(p, "end"));
+        p = end + 1;
+    }
+    return 0;
+}
+
+// keys present replace those in c, "profiles" replaces the whole table; a utc offset
+// without a tz rule clears the rule like the encoder edit does, else it would not apply
+inline void mergeConfig(configuration& c, const configInput& in) {
+    if (in.hasUtc) {
+        c.utcOffset = in.utc;
+        c.tz[0] = '\0';
+    }
+    if (in.hasTz) {
+        memcpy(c.tz, in.tz, sizeof(c.tz));
+    }
+    if (in.hasProfiles) {
+        memcpy(c.profiles, in.profiles, sizeof(c.profiles));
+        c.profileCount = in.profileCount;
+    } else if (in.hasBirth || in.hasDeath) {
+        profile& p = c.profiles[0];
+        setProfile(p, c.profileCount ? p.name : PROFILE_NAME_DEFAULT,
+            in.hasBirth ? in.birth : p.span.start, in.hasDeath ? in.death : p.span.end);
+        c.profileCount = c.profileCount ? c.profileCount : 1;
+    }
+}
+
+// encoder and HTTP edits are checked the same way before they are applied
+inline bool validUtcOffset(float offset) {
+    return offset >= UTC_MIN && offset <= UTC_MAX;
+}
+
+// printable, and nothing that would need escaping in the JSON written back
+inline bool validText(const char* text) {
+    for (const char* p = text; *p; p++) {
+        if (*p < ' ' || *p > '~' || *p == '"' || *p == '\\') {
+            return false;
+        }
+    }
+    return true;
+}
+
+// quoted <...> names of a rule may hold any character, hence validText()
+inline bool validTz(const char* spec) {
+    tzInfo tz;
+    return validText(spec) && (spec[0] == '\0' || tzCompile(tz, spec));
+}
+
+inline bool validName(const char* name) {
+    return name[0] != '\0' && validText(name);
+}
+
+inline bool validSpan(time_t start, time_t end) {
+    return start < end;
+}
+
+// nullptr when valid, else what is wrong
+inline const char* validateConfig(const configuration& c) {
+    if (!validUtcOffset(c.utcOffset)) {
+        return "utc offset out of range";
+    }
+    if (!validTz(c.tz)) {
+        return "invalid tz rule";
+    }
+    if (c.profileCount == 0) {
+        return "no profiles";
+    }
+    for (uint8_t i = 0; i < c.profileCount; i++) {
+        if (!validName(c.profiles[i].name)) {
+            return "invalid profile name";
+        }
+        if (!validSpan(c.profiles[i].span.start, c.profiles[i].span.end)) {
+            return "profile end is not after start";
+        }
+    }
+    return nullptr;
+}
+
+// in merged over a copy of c into edited; nullptr when that is valid, else what is wrong
+inline const char* editConfig(configuration& edited, const configuration& c, const configInput& in) {
+    edited = c;
+    mergeConfig(edited, in);
+    return validateConfig(edited);
+}
+
+// JSON of c, the file format and the HTTP /config body; length or -1 when it does not fit.
+// snprintf into a fixed buffer since Print::printf() would allocate past 64 chars
+inline int formatConfig(char* buffer, int size, const configuration& c) {
+#if FEATURE_FLOAT_PRINTF
+    int n = snprintf(buffer, size, "{\"utc\":%.2f,\"tz\":\"%s\",\"profiles\":[", c.utcOffset, c.tz);
+#else
+    char utc[8];
+    formatRatio(utc, (int32_t) (c.utcOffset * 100), 100, 2);
+    int n = snprintf(buffer, size, "{\"utc\":%s,\"tz\":\"%s\",\"profiles\":[", utc, c.tz);
+#endif
+    for (uint8_t i = 0; i < c.profileCount && n < size; i++) {
+        const profile& p = c.profiles[i];
+        n += snprintf(buffer + n, size - n, "%s{\"name\":\"%s\",\"start\":%lld,\"end\":%lld}",
+            i ? "," : "", p.name, (long long) p.span.start, (long long) p.span.end);
+    }
+    if (n < size) {
+        n += snprintf(buffer + n, size - n, "]}");
+    }
+    return n < size ? n : -1;
+}
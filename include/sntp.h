@@ -0,0 +1,120 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// SNTP packet helpers (RFC 4330)
+// https://www.meinbergglobal.com/english/info/ntp-packet.htm
+
+#define SNTP_PACKET_SIZE 48
+#define SNTP_PACKETS_PER_TICK 4 // datagrams handled per loop(), bounds socket work
+#define SNTP_UNIX_OFFSET 2208988800UL // 1900-01-01 to 1970-01-01
+
+#define SNTP_MODE_CLIENT 3
+#define SNTP_MODE_SERVER 4
+#define SNTP_LI_ALARM 3         // clock not synchronized
+#define SNTP_STRATUM_UNSYNCED 16
+#define SNTP_PRECISION 0xF9     // 2^-7 s, ms clock polled every loop()
+
+// field offsets
+#define SNTP_ROOT_DELAY 4
+#define SNTP_ROOT_DISPERSION 8
+#define SNTP_REF_ID 12
+#define SNTP_REF_TIME 16
+#define SNTP_ORIGIN_TIME 24
+#define SNTP_RX_TIME 32
+#define SNTP_TX_TIME 40
+
+struct sntpTimestamp {
+    uint32_t secs;
+    uint32_t frac;
+};
+
+inline uint32_t sntpReadWord(const uint8_t* p) {
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+}
+
+inline void sntpWriteWord(uint8_t* p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+inline uint8_t sntpMode(const uint8_t* p) {
+    return p[0] & 0x07;
+}
+
+inline uint8_t sntpLeap(const uint8_t* p) {
+    return p[0] >> 6;
+}
+
+inline sntpTimestamp sntpFromUnixMs(uint64_t ms) {
+    sntpTimestamp t;
+    t.secs = (uint32_t) (ms / 1000) + SNTP_UNIX_OFFSET; // wraps into NTP era 1 after 2036
+    t.frac = ((ms % 1000) << 32) / 1000;
+    return t;
+}
+
+inline uint64_t sntpToUnixMs(sntpTimestamp t) {
+    return (uint64_t) (uint32_t) (t.secs - SNTP_UNIX_OFFSET) * 1000 + (((uint64_t) t.frac * 1000) >> 32);
+}
+
+inline sntpTimestamp sntpReadTimestamp(const uint8_t* p) {
+    sntpTimestamp t = {sntpReadWord(p), sntpReadWord(p + 4)};
+    return t;
+}
+
+inline void sntpWriteTimestamp(uint8_t* p, sntpTimestamp t) {
+    sntpWriteWord(p, t.secs);
+    sntpWriteWord(p + 4, t.frac);
+}
+
+// 16.16 fixed point seconds used by root delay/dispersion
+inline uint32_t sntpShortFromMs(uint32_t ms) {
+    return (uint32_t) (((uint64_t) ms << 16) / 1000);
+}
+
+// everything but origin/receive/transmit timestamps, rebuilt once per upstream sync
+inline void sntpBuildTemplate(uint8_t* tmpl, uint8_t stratum, const uint8_t refId[4],
+                              uint32_t rootDelay, uint32_t rootDispersion, sntpTimestamp ref) {
+    memset(tmpl, 0, SNTP_PACKET_SIZE);
+    tmpl[0] = SNTP_MODE_SERVER;
+    tmpl[1] = stratum;
+    tmpl[3] = SNTP_PRECISION;
+    sntpWriteWord(tmpl + SNTP_ROOT_DELAY, rootDelay);
+    sntpWriteWord(tmpl + SNTP_ROOT_DISPERSION, rootDispersion);
+    memcpy(tmpl + SNTP_REF_ID, refId, 4);
+    sntpWriteTimestamp(tmpl + SNTP_REF_TIME, ref);
+}
+
+inline void sntpMarkUnsynced(uint8_t* tmpl) {
+    tmpl[0] = (SNTP_LI_ALARM << 6) | SNTP_MODE_SERVER;
+    tmpl[1] = SNTP_STRATUM_UNSYNCED;
+}
+
+inline bool sntpIsRequest(const uint8_t* p, size_t size) {
+    return size >= SNTP_PACKET_SIZE && sntpMode(p) == SNTP_MODE_CLIENT;
+}
+
+// reply = template + client version/poll + client transmit as origin + our timestamps
+inline void sntpReply(uint8_t* out, const uint8_t* tmpl, const uint8_t* request,
+                      sntpTimestamp rx, sntpTimestamp tx) {
+    memcpy(out, tmpl, SNTP_ORIGIN_TIME);
+    out[0] |= request[0] & 0x38;
+    out[2] = request[2];
+    memcpy(out + SNTP_ORIGIN_TIME, request + SNTP_TX_TIME, 8);
+    sntpWriteTimestamp(out + SNTP_RX_TIME, rx);
+    sntpWriteTimestamp(out + SNTP_TX_TIME, tx);
+}
+
+// client side: server time at arrival, transmit timestamp + half the round trip;
+// false for kiss-o'-death (stratum 0) or a server that is itself not synced
+inline bool sntpReplyTime(const uint8_t* p, uint32_t rttMs, uint64_t* utcMs) {
+    if (sntpMode(p) != SNTP_MODE_SERVER || p[1] == 0 || sntpLeap(p) == SNTP_LI_ALARM) {
+        return false;
+    }
+    *utcMs = sntpToUnixMs(sntpReadTimestamp(p + SNTP_TX_TIME)) + rttMs / 2;
+    return true;
+}
@@ -0,0 +1,339 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// POSIX TZ rules (e.g. "EST5EDT,M3.2.0,M11.1.0") compiled once into offsets and rules;
+// local time is then a compare against the cached transition window and an add.
+// https://pubs.opengroup.org/onlinepubs/9699919799/basedefs/V1_chap08.html
+
+#define TZ_NAME_SIZE 10 // fits "UTC-12:45" of fixed offsets
+#define TZ_SPEC_SIZE 48
+#define TZ_DEFAULT_RULE_TIME 7200 // 02:00:00
+#define TZ_SECS_PER_DAY 86400L
+
+enum tzRuleType {
+    TZ_RULE_JULIAN, // Jn, 1-365, Feb 29 never counted
+    TZ_RULE_DAY,    // n, 0-365, Feb 29 counted
+    TZ_RULE_MONTH,  // Mm.w.d, day d (0=Sun) of week w (5=last) of month m
+};
+
+struct tzRule {
+    uint8_t type;
+    uint8_t month;
+    uint8_t week;
+    uint8_t wday;
+    uint16_t day;
+    int32_t time; // local seconds after midnight
+};
+
+struct tzInfo {
+    int32_t stdOffset; // seconds east of UTC, local = UTC + offset
+    int32_t dstOffset;
+    tzRule start;      // std -> dst
+    tzRule end;        // dst -> std
+    bool hasDst;
+    char stdName[TZ_NAME_SIZE];
+    char dstName[TZ_NAME_SIZE];
+
+    // cached window [prevTransition, nextTransition) where offset applies
+    int64_t prevTransition;
+    int64_t nextTransition;
+    int32_t offset;
+    bool dst;
+};
+
+/*** calendar ***/
+
+// days since 1970-01-01, proleptic Gregorian
+// https://howardhinnant.github.io/date_algorithms.html
+inline int32_t tzDaysFromCivil(int32_t y, uint32_t m, uint32_t d) {
+    y -= m <= 2;
+    int32_t era = (y >= 0 ? y : y - 399) / 400;
+    uint32_t yoe = (uint32_t) (y - era * 400);
+    uint32_t doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int32_t) doe - 719468;
+}
+
+inline void tzCivilFromDays(int32_t z, int32_t* y, uint8_t* m, uint8_t* d) {
+    z += 719468;
+    int32_t era = (z >= 0 ? z : z - 146096) / 146097;
+    uint32_t doe = (uint32_t) (z - era * 146097);
+    uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    uint32_t mp = (5 * doy + 2) / 153;
+    *d = doy - (153 * mp + 2) / 5 + 1;
+    *m = mp < 10 ? mp + 3 : mp - 9;
+    *y = (int32_t) yoe + era * 400 + (*m <= 2);
+}
+
+inline bool tzIsLeap(int32_t y) {
+    return (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+}
+
+inline uint8_t tzDaysInMonth(int32_t y, uint8_t m) {
+    static const uint8_t days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    return (m == 2 && tzIsLeap(y)) ? 29 : days[m - 1];
+}
+
+// days since epoch of a time in seconds, floored for times before 1970
+inline int32_t tzDaysOf(int64_t t) {
+    return (int32_t) (t / TZ_SECS_PER_DAY - (t % TZ_SECS_PER_DAY < 0));
+}
+
+inline void tzDate(int64_t t, int32_t* y, uint8_t* m, uint8_t* d) {
+    tzCivilFromDays(tzDaysOf(t), y, m, d);
+}
+
+// hour, minute and second of the day, also floored before 1970
+inline void tzClock(int64_t t, uint8_t* h, uint8_t* m, uint8_t* s) {
+    int32_t secs = (int32_t) (t - (int64_t) tzDaysOf(t) * TZ_SECS_PER_DAY);
+    *h = secs / 3600;
+    *m = secs / 60 % 60;
+    *s = secs % 60;
+}
+
+inline int32_t tzYearOf(int64_t t) {
+    int32_t y;
+    uint8_t m, d;
+    tzDate(t, &y, &m, &d);
+    return y;
+}
+
+// Jan 1 00:00:00 of year y, in the same local/UTC scale as the times passed to tzYearOf()
+inline int64_t tzYearStart(int32_t y) {
+    return (int64_t) tzDaysFromCivil(y, 1, 1) * TZ_SECS_PER_DAY;
+}
+
+// weekday of days since epoch, 0=Sunday (1970-01-01 was a Thursday)
+inline uint8_t tzWeekday(int32_t days) {
+    return (uint8_t) ((days % 7 + 11) % 7);
+}
+
+/*** parsing ***/
+
+inline const char* tzParseName(const char* p, char* name) {
+    uint8_t n = 0;
+
+    if (*p == '<') {
+        for (p++; *p && *p != '>'; p++) {
+            if (n < TZ_NAME_SIZE - 1) {
+                name[n++] = *p;
+            }
+        }
+        if (*p++ != '>') {
+            return nullptr;
+        }
+    } else {
+        for (; (*p >= 'A' && *p <= 'Z') || (*p >= 'a' && *p <= 'z'); p++) {
+            if (n < TZ_NAME_SIZE - 1) {
+                name[n++] = *p;
+            }
+        }
+    }
+    name[n] = '\0';
+    return n >= 3 ? p : nullptr;
+}
+
+inline const char* tzParseNumber(const char* p, int32_t* value, int32_t max) {
+    if (*p < '0' || *p > '9') {
+        return nullptr;
+    }
+    for (*value = 0; *p >= '0' && *p <= '9'; p++) {
+        *value = *value * 10 + (*p - '0');
+    }
+    return *value <= max ? p : nullptr;
+}
+
+// [+-]hh[:mm[:ss]] in seconds
+inline const char* tzParseTime(const char* p, int32_t* secs) {
+    int32_t sign = 1, h, m = 0, s = 0;
+
+    if (*p == '+' || *p == '-') {
+        sign = (*p++ == '-') ? -1 : 1;
+    }
+    if (!(p = tzParseNumber(p, &h, 167))) {
+        return nullptr;
+    }
+    if (*p == ':' && !(p = tzParseNumber(p + 1, &m, 59))) {
+        return nullptr;
+    }
+    if (*p == ':' && !(p = tzParseNumber(p + 1, &s, 59))) {
+        return nullptr;
+    }
+    *secs = sign * (h * 3600 + m * 60 + s);
+    return p;
+}
+
+inline const char* tzParseRule(const char* p, tzRule* r) {
+    int32_t v, w, d;
+
+    if (*p == 'M') {
+        if (!(p = tzParseNumber(p + 1, &v, 12)) || *p != '.' || !(p = tzParseNumber(p + 1, &w, 5))
+                || *p != '.' || !(p = tzParseNumber(p + 1, &d, 6)) || v < 1 || w < 1) {
+            return nullptr;
+        }
+        r->type = TZ_RULE_MONTH;
+        r->month = v;
+        r->week = w;
+        r->wday = d;
+    } else if (*p == 'J') {
+        if (!(p = tzParseNumber(p + 1, &v, 365)) || v < 1) {
+            return nullptr;
+        }
+        r->type = TZ_RULE_JULIAN;
+        r->day = v;
+    } else {
+        if (!(p = tzParseNumber(p, &v, 365))) {
+            return nullptr;
+        }
+        r->type = TZ_RULE_DAY;
+        r->day = v;
+    }
+    r->time = TZ_DEFAULT_RULE_TIME;
+
+    if (*p == '/' && !(p = tzParseTime(p + 1, &r->time))) {
+        return nullptr;
+    }
+    return p;
+}
+
+inline void tzInvalidate(tzInfo& tz) {
+    tz.prevTransition = INT64_MAX; // forces tzUpdate() on next lookup
+    tz.nextTransition = INT64_MIN;
+}
+
+// named after the offset, "UTC", "UTC-5" or "UTC+5:30"
+inline void tzFixed(tzInfo& tz, int32_t offsetSecs) {
+    memset(&tz, 0, sizeof(tz));
+    tz.stdOffset = tz.dstOffset = offsetSecs;
+
+    int32_t mins = (offsetSecs < 0 ? -offsetSecs : offsetSecs) / 60;
+    char* p = tz.stdName + snprintf(tz.stdName, TZ_NAME_SIZE, "UTC");
+
+    if (mins) {
+        p += snprintf(p, TZ_NAME_SIZE - 3, "%c%d", offsetSecs < 0 ? '-' : '+', (int) (mins / 60));
+    }
+    if (mins % 60) {
+        snprintf(p, tz.stdName + TZ_NAME_SIZE - p, ":%02d", (int) (mins % 60));
+    }
+    tzInvalidate(tz);
+}
+
+// false on malformed spec, tz is left untouched then
+inline bool tzCompile(tzInfo& tz, const char* spec) {
+    tzInfo t;
+    memset(&t, 0, sizeof(t));
+    const char* p = tzParseName(spec, t.stdName);
+
+    // POSIX offsets are west of UTC, store east
+    if (!p || !(p = tzParseTime(p, &t.stdOffset))) {
+        return false;
+    }
+    t.stdOffset = -t.stdOffset;
+    t.dstOffset = t.stdOffset;
+
+    if (*p) {
+        if (!(p = tzParseName(p, t.dstName))) {
+            return false;
+        }
+        t.hasDst = true;
+        t.dstOffset = t.stdOffset + 3600;
+
+        if (*p && *p != ',') {
+            if (!(p = tzParseTime(p, &t.dstOffset))) {
+                return false;
+            }
+            t.dstOffset = -t.dstOffset;
+        }
+        if (*p == ',') {
+            if (!(p = tzParseRule(p + 1, &t.start)) || *p != ',' || !(p = tzParseRule(p + 1, &t.end))) {
+                return false;
+            }
+        } else {
+            tzParseRule("M3.2.0", &t.start); // US rules when omitted, same as glibc
+            tzParseRule("M11.1.0", &t.end);
+        }
+    }
+    if (*p) {
+        return false;
+    }
+    tzInvalidate(t);
+    tz = t;
+    return true;
+}
+
+/*** lookup ***/
+
+// local midnight of rule day, as days since epoch
+inline int32_t tzRuleDay(const tzRule& r, int32_t y) {
+    int32_t jan1 = tzDaysFromCivil(y, 1, 1);
+
+    switch (r.type) {
+        case TZ_RULE_JULIAN:
+            return jan1 + r.day - 1 + (tzIsLeap(y) && r.day >= 60);
+        case TZ_RULE_DAY:
+            return jan1 + r.day;
+        default: {
+            int32_t first = tzDaysFromCivil(y, r.month, 1);
+            int32_t day = (r.wday - tzWeekday(first) + 7) % 7 + (r.week - 1) * 7;
+
+            while (day >= tzDaysInMonth(y, r.month)) {
+                day -= 7; // week 5 = last
+            }
+            return first + day;
+        }
+    }
+}
+
+// rule time is given in the local time in effect before the transition
+inline int64_t tzTransition(const tzRule& r, int32_t y, int32_t offsetBefore) {
+    return (int64_t) tzRuleDay(r, y) * TZ_SECS_PER_DAY + r.time - offsetBefore;
+}
+
+// rebuilds the cached window around utc, only runs at transitions
+inline void tzUpdate(tzInfo& tz, int64_t utc) {
+    tz.offset = tz.stdOffset;
+    tz.dst = false;
+    tz.prevTransition = INT64_MIN;
+    tz.nextTransition = INT64_MAX;
+
+    if (!tz.hasDst) {
+        return;
+    }
+    int32_t y = tzYearOf(utc + tz.stdOffset);
+
+    for (int32_t i = y - 1; i <= y + 1; i++) {
+        int64_t start = tzTransition(tz.start, i, tz.stdOffset);
+        int64_t end = tzTransition(tz.end, i, tz.dstOffset);
+
+        if (start <= utc && start > tz.prevTransition) {
+            tz.prevTransition = start;
+            tz.dst = true;
+        }
+        if (end <= utc && end > tz.prevTransition) {
+            tz.prevTransition = end;
+            tz.dst = false;
+        }
+        if (start > utc && start < tz.nextTransition) {
+            tz.nextTransition = start;
+        }
+        if (end > utc && end < tz.nextTransition) {
+            tz.nextTransition = end;
+        }
+    }
+    tz.offset = tz.dst ? tz.dstOffset : tz.stdOffset;
+}
+
+inline int64_t tzLocal(tzInfo& tz, int64_t utc) {
+    if (utc >= tz.nextTransition || utc < tz.prevTransition) {
+        tzUpdate(tz, utc);
+    }
+    return utc + tz.offset;
+}
+
+inline const char* tzName(const tzInfo& tz) {
+    return tz.dst ? tz.dstName : tz.stdName;
+}
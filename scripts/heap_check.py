@@ -0,0 +1,104 @@
+#!/usr/bin/env python3
+"""Flags heap allocation reachable from loop() and the ISRs.
+
+Reads the GCC call graphs (-fcallgraph-info .ci files) of a build, walks every
+call reachable from the roots and reports the shortest chain to each allocating
+function. Calls through function pointers are not visible to GCC and are not
+followed. Used by `make heapcheck`, exits non-zero on any finding.
+"""
+
+import argparse
+import glob
+import os
+import re
+import sys
+from collections import deque
+
+NODE = re.compile(r'node: \{ title: "([^"]+)" label: "([^"]*)"')
+EDGE = re.compile(r'edge: \{ sourcename: "([^"]+)" targetname: "([^"]+)" label: "([^"]*)"')
+
+ALLOCATORS = [
+    r'\b(malloc|calloc|realloc|strdup|strndup|umm_malloc)\(',
+    r'\boperator new',
+    r'\bString::(String|concat|reserve|operator\+?=)\(',
+    r'\bIPAddress::toString\(',
+    r'\bbasic_string<.*>::(basic_string|_M_create|append|reserve)\(',
+]
+
+
+def signature(label):
+    return label.split('\\n')[0]
+
+
+def load(build_dir):
+    labels, calls = {}, {}
+    files = glob.glob(os.path.join(build_dir, '**', '*.ci'), recursive=True)
+
+    for path in files:
+        with open(path, errors='replace') as f:
+            for line in f:
+                m = NODE.search(line)
+                if m:
+                    # a definition (no ellipse shape) wins over an external declaration
+                    if m.group(1) not in labels or 'ellipse' not in line:
+                        labels[m.group(1)] = m.group(2)
+                    continue
+                m = EDGE.search(line)
+                if m:
+                    calls.setdefault(m.group(1), []).append((m.group(2), m.group(3)))
+    return files, labels, calls
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('build_dir')
+    parser.add_argument('--root', action='append', default=[], help='function name to start from, repeatable')
+    parser.add_argument('--allow', action='append', default=[], help='regex of functions accepted as bounded, not followed')
+    args = parser.parse_args()
+
+    files, labels, calls = load(args.build_dir)
+    if not files:
+        sys.exit(f'error: no .ci files under {args.build_dir}, build with -fcallgraph-info first')
+
+    roots = [t for t, l in labels.items()
+             if any(re.search(rf'(^|[\s:*&]){re.escape(r)}\(', signature(l)) for r in args.root)]
+    if not roots:
+        sys.exit('error: roots not found in call graph: ' + ', '.join(args.root))
+
+    allocators = [re.compile(p) for p in ALLOCATORS]
+    allowed = [re.compile(p) for p in args.allow]
+    parent = {r: None for r in roots}
+    queue = deque(roots)
+    findings = []
+
+    while queue:
+        fn = queue.popleft()
+        for callee, site in calls.get(fn, []):
+            if callee in parent:
+                continue
+            parent[callee] = (fn, site)
+            name = signature(labels.get(callee, callee))
+
+            if any(p.search(name) for p in allowed):
+                continue
+            if any(p.search(name) for p in allocators):
+                findings.append(callee)
+            else:
+                queue.append(callee)
+
+    for callee in findings:
+        chain = []
+        node = callee
+        while parent[node]:
+            caller, site = parent[node]
+            chain.append(f'    {signature(labels.get(node, node))}  [{site}]')
+            node = caller
+        chain.append(f'    {signature(labels.get(node, node))}')
+        print('heap allocation reachable:\n' + '\n'.join(reversed(chain)))
+
+    print(f'{len(parent)} functions reachable from {", ".join(args.root)}, {len(findings)} allocating')
+    return 1 if findings else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,153 @@
+#!/usr/bin/env python3
+"""Flash/IRAM/DRAM usage of the firmware ELF, per symbol and per module.
+
+Exits non-zero when a region exceeds its budget, used by `make size`.
+"""
+
+import argparse
+import os
+import re
+import shutil
+import subprocess
+import sys
+from collections import defaultdict
+
+TOOLCHAIN_PREFIX = 'xtensa-lx106-elf-'
+TOOLCHAIN_DIR = os.path.expanduser('~/.platformio/packages/toolchain-xtensa/bin')
+
+# ESP8266 address map
+IRAM = (0x40100000, 0x40110000)
+DRAM = (0x3FFE8000, 0x40000000)
+FLASH = (0x40200000, 0x40400000)
+
+MAP_START = 'Linker script and memory map'
+MAP_INPUT = re.compile(r'^\s+(\S+)?\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S.*)$')
+
+
+def tool(name):
+    path = shutil.which(TOOLCHAIN_PREFIX + name) or os.path.join(TOOLCHAIN_DIR, TOOLCHAIN_PREFIX + name)
+    if not os.path.exists(path):
+        sys.exit(f'error: {TOOLCHAIN_PREFIX}{name} not found, build once with platformio first')
+    return path
+
+
+def region(addr):
+    for name, (lo, hi) in (('iram', IRAM), ('dram', DRAM), ('flash', FLASH)):
+        if lo <= addr < hi:
+            return name
+    return None
+
+
+def section_totals(elf):
+    """(flash image, iram, dram) from section headers."""
+    out = subprocess.run([tool('size'), '-A', '-d', elf], capture_output=True, text=True, check=True).stdout
+    totals = defaultdict(int)
+
+    for line in out.splitlines():
+        parts = line.split()
+        if len(parts) != 3 or not parts[1].isdigit() or not parts[2].isdigit():
+            continue
+        name, size, addr = parts[0], int(parts[1]), int(parts[2])
+        r = region(addr)
+        if r is None or size == 0:
+            continue
+        if r != 'flash':
+            totals[r] += size
+        if 'bss' not in name and 'noinit' not in name:
+            totals['flash'] += size  # everything but zero-init is stored in the image
+    return totals
+
+
+def symbols(elf):
+    out = subprocess.run([tool('nm'), '-S', '-C', '--size-sort', elf], capture_output=True, text=True, check=True).stdout
+    result = defaultdict(list)
+
+    for line in out.splitlines():
+        parts = line.split(None, 3)
+        if len(parts) != 4:
+            continue
+        r = region(int(parts[0], 16))
+        if r:
+            result[r].append((int(parts[1], 16), parts[3]))
+    return result
+
+
+def module_name(path):
+    m = re.match(r'(.*\.a)\((.*)\)$', path.strip())
+    if m:
+        return os.path.basename(m.group(1))
+    return os.path.basename(path.strip())
+
+
+def modules(map_path):
+    """Bytes per archive/object and region, from the linker map."""
+    result = defaultdict(lambda: defaultdict(int))
+    pending = None
+    started = False
+
+    with open(map_path, errors='replace') as f:
+        for line in f:
+            if not started:
+                started = line.startswith(MAP_START)
+                continue
+            # long input section names wrap onto the next line
+            if pending and line.startswith(' ' * 8):
+                line = ' ' + pending + line
+            pending = None
+
+            m = MAP_INPUT.match(line)
+            if not m:
+                stripped = line.strip()
+                if line.startswith(' .') and len(stripped.split()) == 1:
+                    pending = stripped
+                continue
+            name, addr, size, path = m.groups()
+            addr, size = int(addr, 16), int(size, 16)
+            r = region(addr)
+
+            if r and size and name and name != '*fill*' and not path.startswith('0x'):
+                result[r][module_name(path)] += size
+    return result
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('elf')
+    parser.add_argument('--map', help='linker map for the per-module breakdown')
+    parser.add_argument('--top', type=int, default=15, help='symbols/modules listed per region')
+    parser.add_argument('--flash', type=int, default=0, help='flash image budget in bytes, 0 = none')
+    parser.add_argument('--iram', type=int, default=0, help='IRAM budget in bytes, 0 = none')
+    parser.add_argument('--dram', type=int, default=0, help='DRAM (data+rodata+bss) budget in bytes, 0 = none')
+    args = parser.parse_args()
+
+    totals = section_totals(args.elf)
+    syms = symbols(args.elf)
+    mods = modules(args.map) if args.map and os.path.exists(args.map) else {}
+    budgets = {'flash': args.flash, 'iram': args.iram, 'dram': args.dram}
+    over = []
+
+    print(f'{"region":<8}{"used":>10}{"budget":>10}{"used %":>9}')
+    for r in ('flash', 'iram', 'dram'):
+        used, budget = totals[r], budgets[r]
+        pct = f'{100.0 * used / budget:.1f}' if budget else '-'
+        print(f'{r:<8}{used:>10}{budget or "-":>10}{pct:>9}')
+        if budget and used > budget:
+            over.append(f'{r} {used} > {budget} (+{used - budget})')
+
+    for r in ('flash', 'iram', 'dram'):
+        if mods.get(r):
+            print(f'\n{r} by module')
+            for name, size in sorted(mods[r].items(), key=lambda i: -i[1])[:args.top]:
+                print(f'{size:>10}  {name}')
+        print(f'\n{r} by symbol')
+        for size, name in sorted(syms[r], reverse=True)[:args.top]:
+            print(f'{size:>10}  {name}')
+
+    if over:
+        print('\nerror: size budget exceeded: ' + ', '.join(over), file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Shared by the host harnesses in sim/: an option table parsed from argv with the
+// usage line generated from it, and the failure count every check reports into.
+
+#define HOST_MAX_FAILURES_SHOWN 10
+
+enum hostOptionType {
+    HOST_FLAG,   // bool, no value
+    HOST_UINT,   // uint32_t
+    HOST_INT,    // int32_t
+    HOST_DOUBLE,
+    HOST_STRING, // const char*
+};
+
+struct hostOption {
+    const char* name; // "--port"
+    hostOptionType type;
+    void* value;
+};
+
+inline uint32_t hostFailures = 0;
+
+// counted always, printed up to HOST_MAX_FAILURES_SHOWN
+inline void hostFail(const char* format, ...) __attribute__((format(printf, 1, 2)));
+
+inline void hostFail(const char* format, ...) {
+    if (hostFailures++ >= HOST_MAX_FAILURES_SHOWN) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    printf("FAIL ");
+    vprintf(format, args);
+    printf("\n");
+    va_end(args);
+}
+
+// prints the summary line, the exit code of main()
+inline int hostResult() {
+    printf("failures: %u\n", hostFailures);
+    return hostFailures ? 1 : 0;
+}
+
+template <size_t N>
+[[noreturn]] void hostUsage(const char* name, const hostOption (&options)[N]) {
+    fprintf(stderr, "usage: %s", name);
+
+    for (const hostOption& o : options) {
+        fprintf(stderr, o.type == HOST_FLAG ? " [%s]" : " [%s %s]", o.name,
+            o.type == HOST_STRING ? "VALUE" : "N");
+    }
+    fprintf(stderr, "\n");
+    exit(2);
+}
+
+template <size_t N>
+void hostParseOptions(int argc, char** argv, const hostOption (&options)[N]) {
+    for (int i = 1; i < argc; i++) {
+        const hostOption* o = nullptr;
+
+        for (const hostOption& candidate : options) {
+            o = strcmp(argv[i], candidate.name) == 0 ? &candidate : o;
+        }
+        if (!o || (o->type != HOST_FLAG && i + 1 == argc)) {
+            hostUsage(argv[0], options);
+        }
+        const char* v = o->type == HOST_FLAG ? nullptr : argv[++i];
+
+        switch (o->type) {
+            case HOST_FLAG:
+                *(bool*) o->value = true;
+                break;
+            case HOST_UINT:
+                *(uint32_t*) o->value = strtoul(v, nullptr, 10);
+                break;
+            case HOST_INT:
+                *(int32_t*) o->value = strtol(v, nullptr, 10);
+                break;
+            case HOST_DOUBLE:
+                *(double*) o->value = strtod(v, nullptr);
+                break;
+            case HOST_STRING:
+                *(const char**) o->value = v;
+                break;
+        }
+    }
+}
@@ -0,0 +1,617 @@
+// Host harness for the HTTP API, serves api.h/http.h from a POSIX socket:
+//
+//   make http-host                                     # self test with a local client, exits 1 on failure
+//   make http-host HTTP_ARGS="--serve --budget 16"     # keep serving, then:
+//   curl -s localhost:8080/status
+//   curl -s -d '{"utc":1}' localhost:8080/config
+//
+// Mirrors updateHttp() in main.cpp: one connection at a time, at most --budget bytes
+// parsed per --tick ms pass, the request body lands in a CONFIG_BUFFER_SIZE buffer and
+// the response is streamed through HTTP_BUFFER_SIZE. Routing and responses are the
+// firmware's apiResolve()/apiServe*(), POST /config goes through the same parse and
+// editConfig() as applyConfig(), read with the minimal JSON reader (FEATURE_ARDUINOJSON 0).
+// The self test checks status codes and error bodies of every route, that 200 bodies
+// are valid JSON also with every /status value at full width, that configs round-trip
+// (profile names equal to root keys included) and that rejected ones change nothing.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "api.h"
+#include "host.h"
+#include "pages.h"
+#include "settings.h"
+
+/*** constants ***/
+
+#define HOST_WAIT_MS (HTTP_TIMEOUT_MS + 1000) // per request in the self test, outlasts a 408
+#define HOST_RESPONSE_SIZE 2048
+
+/*** types ***/
+
+struct httpHostOptions {
+    uint32_t port;
+    uint32_t budget; // bytes parsed per tick
+    uint32_t tickMs;
+    bool serve;
+};
+
+struct hostConnection {
+    int fd;
+    httpRequest request;
+    uint32_t startMs;
+    bool active;
+};
+
+struct hostOut {
+    int fd;
+    size_t written;
+
+    void write(const uint8_t* p, size_t size) {
+        while (size) {
+            ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+
+            if (n < 0 && errno == EAGAIN) {
+                continue; // firmware blocks in WiFiClient::write() the same way
+            }
+            if (n <= 0) {
+                return;
+            }
+            p += n;
+            size -= n;
+            written += n;
+        }
+    }
+};
+
+// response captured in memory, for the worst case that no socket request can produce
+struct textOut {
+    char text[HOST_RESPONSE_SIZE];
+    size_t size;
+
+    void write(const uint8_t* p, size_t n) {
+        n = n < HOST_RESPONSE_SIZE - 1 - size ? n : HOST_RESPONSE_SIZE - 1 - size;
+        memcpy(text + size, p, n);
+        size += n;
+        text[size] = '\0';
+    }
+};
+
+struct hostResponse {
+    char text[HOST_RESPONSE_SIZE];
+    size_t size;
+    int code;
+    const char* body;
+};
+
+// one request of the self test, error is the expected {"error":...} message
+struct routeCase {
+    const char* method;
+    const char* path;
+    const char* body; // nullptr = no Content-Length
+    int code;
+    const char* error;
+};
+
+/*** globals ***/
+
+httpHostOptions options = {8080, HTTP_BYTES_PER_TICK, 1, false};
+const hostOption optionTable[] = {
+    {"--port", HOST_UINT, &options.port},
+    {"--budget", HOST_UINT, &options.budget},
+    {"--tick", HOST_UINT, &options.tickMs},
+    {"--serve", HOST_FLAG, &options.serve},
+};
+int server = -1;
+hostConnection http = {-1, {}, 0, false};
+char configBuffer[CONFIG_BUFFER_SIZE];
+char httpBuffer[HTTP_BUFFER_SIZE];
+configuration config;
+configInput configIn;
+configuration editedConfig;
+tzInfo zone;
+apiStatus status;
+char statusLocal[DISPLAY_BUFFER_SIZE];
+uint32_t bootMs;
+uint32_t requests = 0;
+
+const routeCase routeCases[] = {
+    {"GET", "/", nullptr, 200, nullptr},
+    {"GET", "/status?pretty=1", nullptr, 200, nullptr},
+    {"GET", "/config", nullptr, 200, nullptr},
+    {"POST", "/status", "", 405, "use GET"},
+    {"PUT", "/config", "{}", 405, "use GET or POST"},
+    {"GET", "/missing", nullptr, 404, "not found"},
+    {"POST", "/config", "[1]", 400, "invalid JSON"},
+    {"POST", "/config", "{\"profiles\":{}}", 400, "invalid JSON"},
+    {"POST", "/config", "{\"utc\":20}", 400, "utc offset out of range"},
+    {"POST", "/config", "{\"tz\":\"EST5EDT,M13.2.0\"}", 400, "invalid tz rule"},
+    {"POST", "/config", "{\"profiles\":[]}", 400, "no profiles"},
+    {"POST", "/config", "{\"profiles\":[{\"name\":\"\",\"start\":0,\"end\":1}]}", 400, "invalid profile name"},
+    {"POST", "/config", "{\"profiles\":[{\"name\":\"a\",\"start\":1,\"end\":1}]}", 400, "profile end is not after start"},
+};
+
+// root keys and JSON punctuation as profile names, each must stay a name
+const char* trickyNames[] = {"start", "utc", "tz", "}]{,:", "profiles"};
+
+/*** helpers ***/
+
+uint32_t hostMs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000UL + ts.tv_nsec / 1000000;
+}
+
+const char* jsonSkipSpace(const char* p) {
+    return p + strspn(p, " \t\r\n");
+}
+
+// end of the strict JSON value at p, nullptr when it is not one
+const char* jsonValue(const char* p) {
+    p = jsonSkipSpace(p);
+
+    if (*p == '{' || *p == '[') {
+        char close = *p == '{' ? '}' : ']';
+        p = jsonSkipSpace(p + 1);
+
+        if (*p == close) {
+            return p + 1;
+        }
+        while (true) {
+            if (close == '}') {
+                p = *p == '"' ? jsonValue(p) : nullptr;
+                p = p ? jsonSkipSpace(p) : nullptr;
+
+                if (!p || *p++ != ':') {
+                    return nullptr;
+                }
+            }
+            if (!(p = jsonValue(p))) {
+                return nullptr;
+            }
+            p = jsonSkipSpace(p);
+
+            if (*p == close) {
+                return p + 1;
+            }
+            if (*p++ != ',') {
+                return nullptr;
+            }
+            p = jsonSkipSpace(p);
+        }
+    }
+    if (*p == '"') {
+        for (p++; *p != '"'; p++) {
+            if ((unsigned char) *p < ' ') {
+                return nullptr;
+            }
+            if (*p == '\\' && (!*++p || !strchr("\"\\/bfnrtu", *p))) {
+                return nullptr;
+            }
+        }
+        return p + 1;
+    }
+    static const char* literals[] = {"true", "false", "null"};
+
+    for (const char* literal : literals) {
+        if (strncmp(p, literal, strlen(literal)) == 0) {
+            return p + strlen(literal);
+        }
+    }
+    // -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+    const char* start = p += *p == '-';
+
+    if (*p == '0') {
+        p++;
+    } else {
+        p += strspn(p, "0123456789");
+    }
+    if (p == start) {
+        return nullptr;
+    }
+    if (*p == '.') {
+        size_t n = strspn(++p, "0123456789");
+        p = n ? p + n : nullptr;
+    }
+    if (p && (*p == 'e' || *p == 'E')) {
+        p += 1 + (p[1] == '+' || p[1] == '-');
+        size_t n = strspn(p, "0123456789");
+        p = n ? p + n : nullptr;
+    }
+    return p;
+}
+
+bool jsonValid(const char* text) {
+    const char* end = jsonValue(text);
+    return end && *jsonSkipSpace(end) == '\0';
+}
+
+/*** server ***/
+
+// compileZone() of the firmware
+void compileZone() {
+    if (!config.tz[0] || !tzCompile(zone, config.tz)) {
+        tzFixed(zone, config.utcOffset * PAGE_SECS_PER_HOUR);
+    }
+}
+
+// what serveStatus() gathers, from the host clock
+void updateStatus(uint32_t ms) {
+    timeFrame frame = {};
+    frameUpdate(frame, zone, time(nullptr));
+    formatClock(statusLocal, DISPLAY_BUFFER_SIZE, frame);
+
+    status = {};
+    status.utc = frame.utc;
+    status.local = statusLocal;
+    status.zone = tzName(zone);
+    status.source = "ntp";
+    status.ntpServer = "localhost";
+    status.lastSyncSecs = -1;
+    status.ip[0] = 127;
+    status.ip[3] = 1;
+    status.radioSleep = "none";
+    status.uptimeSecs = (ms - bootMs) / 1000;
+}
+
+// applyConfig() of the firmware
+void applyConfig(hostOut& out) {
+    const char* err = readConfig(configBuffer, configIn) ? "invalid JSON" : editConfig(editedConfig, config, configIn);
+
+    if (err) {
+        httpError(out, httpBuffer, HTTP_BUFFER_SIZE, 400, err);
+        return;
+    }
+    config = editedConfig;
+    compileZone();
+    apiServeConfig(out, httpBuffer, HTTP_BUFFER_SIZE, configBuffer, config);
+}
+
+// respondHttp() of the firmware
+void respond(httpParse result, uint32_t ms) {
+    hostOut out = {http.fd, 0};
+    const httpRequest& r = http.request;
+    int code;
+    const char* message;
+
+    switch (apiResolve(result, r, &code, &message)) {
+        case API_STATUS:
+            apiServeStatus(out, httpBuffer, HTTP_BUFFER_SIZE, configBuffer, status, config);
+            break;
+        case API_CONFIG:
+            apiServeConfig(out, httpBuffer, HTTP_BUFFER_SIZE, configBuffer, config);
+            break;
+        case API_CONFIG_EDIT:
+            applyConfig(out);
+            break;
+        case API_ERROR:
+            httpError(out, httpBuffer, HTTP_BUFFER_SIZE, code, message);
+            break;
+    }
+    if (options.serve) {
+        printf("%s %s -> %zu bytes, %u ms\n", r.method[0] ? r.method : "-", r.path[0] ? r.path : "-",
+            out.written, ms - http.startMs);
+    }
+}
+
+void closeConnection() {
+    close(http.fd);
+    http.fd = -1;
+    http.active = false;
+}
+
+void updateHttp(uint32_t ms) {
+    if (!http.active) {
+        http.fd = accept(server, nullptr, nullptr);
+
+        if (http.fd < 0) {
+            return;
+        }
+        fcntl(http.fd, F_SETFL, O_NONBLOCK);
+        httpBegin(http.request);
+        http.startMs = ms;
+        http.active = true;
+    }
+    httpParse result = HTTP_PARSE_MORE;
+    bool closed = false;
+
+    for (uint32_t i = 0; i < options.budget && result == HTTP_PARSE_MORE; i++) {
+        char c;
+        ssize_t n = recv(http.fd, &c, 1, 0);
+
+        if (n <= 0) {
+            closed = n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+            break;
+        }
+        result = httpFeed(http.request, c, configBuffer, CONFIG_BUFFER_SIZE);
+    }
+    if (result == HTTP_PARSE_MORE) {
+        if (!closed && (ms - http.startMs) < HTTP_TIMEOUT_MS) {
+            return;
+        }
+        if (!closed) {
+            hostOut out = {http.fd, 0};
+            httpError(out, httpBuffer, HTTP_BUFFER_SIZE, 408, "timeout");
+        }
+    } else {
+        requests++;
+        updateStatus(ms);
+        respond(result, ms);
+    }
+    closeConnection();
+}
+
+int openServer(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (fd < 0 || bind(fd, (sockaddr*) &addr, sizeof(addr)) || listen(fd, 4)) {
+        perror("Error: listen failed");
+        exit(1);
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    return fd;
+}
+
+/*** client ***/
+
+// raw request over a fresh connection, served by updateHttp() passes until it is closed;
+// requests are sent whole and read whole by the server so the close never resets
+bool exchange(const char* request, hostResponse& res) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(options.port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    res.size = 0;
+    res.code = 0;
+    res.body = nullptr;
+
+    if (fd < 0 || connect(fd, (sockaddr*) &addr, sizeof(addr))) {
+        perror("Error: connect failed");
+        exit(1);
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    send(fd, request, strlen(request), MSG_NOSIGNAL);
+
+    uint32_t startMs = hostMs();
+    bool closed = false;
+
+    while (!closed && hostMs() - startMs < HOST_WAIT_MS && res.size < HOST_RESPONSE_SIZE - 1) {
+        updateHttp(hostMs());
+        ssize_t n = recv(fd, res.text + res.size, HOST_RESPONSE_SIZE - 1 - res.size, 0);
+
+        if (n > 0) {
+            res.size += n;
+            continue;
+        }
+        closed = n == 0 || errno != EAGAIN;
+        usleep(options.tickMs * 1000);
+    }
+    close(fd);
+    res.text[res.size] = '\0';
+    char* body = strstr(res.text, "\r\n\r\n");
+
+    if (!closed || !body || sscanf(res.text, "HTTP/1.0 %d ", &res.code) != 1) {
+        return false;
+    }
+    res.body = body + 4;
+    return strstr(res.text, "\r\nContent-Type: application/json\r\n") != nullptr;
+}
+
+bool exchange(const char* method, const char* path, const char* body, hostResponse& res) {
+    char request[CONFIG_BUFFER_SIZE + 128];
+
+    if (body) {
+        snprintf(request, sizeof(request), "%s %s HTTP/1.1\r\nHost: localhost\r\nContent-Length: %zu\r\n\r\n%s",
+            method, path, strlen(body), body);
+    } else {
+        snprintf(request, sizeof(request), "%s %s HTTP/1.1\r\nHost: localhost\r\n\r\n", method, path);
+    }
+    return exchange(request, res);
+}
+
+// status code and, for errors, the exact {"error":...} body; 200 bodies must be JSON
+bool checkResponse(const char* name, bool ok, const hostResponse& res, int code, const char* error) {
+    char expected[HTTP_BUFFER_SIZE];
+    snprintf(expected, sizeof(expected), "{\"error\":\"%s\"}\n", error ? error : "");
+
+    if (!ok) {
+        hostFail("%s: no complete JSON response (%zu bytes)", name, res.size);
+    } else if (res.code != code) {
+        hostFail("%s: status %d, expected %d: %s", name, res.code, code, res.body);
+    } else if (error && strcmp(res.body, expected) != 0) {
+        hostFail("%s: body %s, expected %s", name, res.body, expected);
+    } else if (!jsonValid(res.body)) {
+        hostFail("%s: body is not valid JSON: %s", name, res.body);
+    } else {
+        return true;
+    }
+    return false;
+}
+
+// GET /config and the config of /status must both be exactly formatConfig() of expected
+void checkConfig(const char* name, const configuration& expected) {
+    char json[CONFIG_BUFFER_SIZE];
+    char tail[CONFIG_BUFFER_SIZE + 2];
+    hostResponse res;
+
+    if (formatConfig(json, sizeof(json), expected) < 0) {
+        hostFail("%s: expected config does not fit CONFIG_BUFFER_SIZE", name);
+        return;
+    }
+    bool ok = exchange("GET", "/config", nullptr, res);
+
+    if (checkResponse(name, ok, res, 200, nullptr) && (strncmp(res.body, json, strlen(json)) || strcmp(res.body + strlen(json), "\n"))) {
+        hostFail("%s: GET /config %s, expected %s", name, res.body, json);
+    }
+    snprintf(tail, sizeof(tail), "%s}\n", json);
+    ok = exchange("GET", "/status", nullptr, res);
+
+    if (checkResponse(name, ok, res, 200, nullptr) && (strlen(res.body) < strlen(tail) || strcmp(res.body + strlen(res.body) - strlen(tail), tail))) {
+        hostFail("%s: /status does not end with the config", name);
+    }
+}
+
+void checkRoutes() {
+    const char* raw[][3] = {
+        {"GARBAGE\r\n", "400", "bad request"},
+        {"POST /config HTTP/1.0\r\nContent-Length: 512\r\n\r\n", "413", "body too large"},
+        {"GET /status HTTP/1.0\r\n", "408", "timeout"},
+    };
+    configuration before = config;
+    hostResponse res;
+
+    for (const routeCase& c : routeCases) {
+        char name[64];
+        snprintf(name, sizeof(name), "%s %s", c.method, c.path);
+        checkResponse(name, exchange(c.method, c.path, c.body, res), res, c.code, c.error);
+    }
+    for (const auto& r : raw) {
+        checkResponse(r[2], exchange(r[0], res), res, atoi(r[1]), r[2]);
+    }
+    checkConfig("rejected edits", before);
+    printf("routes: %zu requests\n", sizeof(routeCases) / sizeof(routeCases[0]) + sizeof(raw) / sizeof(raw[0]));
+}
+
+// hand written body in another key order with root key names, then what came back posted again
+void checkRoundTrip() {
+    char body[CONFIG_BUFFER_SIZE];
+    configuration expected = config;
+    hostResponse res;
+    int n = snprintf(body, sizeof(body), "{ \"profiles\" : [");
+
+    expected.profileCount = 0;
+    expected.utcOffset = 5.75f;
+    expected.tz[0] = '\0';
+
+    for (const char* name : trickyNames) {
+        if (expected.profileCount == PROFILE_MAX) {
+            break;
+        }
+        time_t start = -1000 + expected.profileCount * 1000;
+        n += snprintf(body + n, sizeof(body) - n, "%s\n  {\"end\": %lld, \"name\": \"%s\", \"start\": %lld}",
+            expected.profileCount ? "," : "", (long long) start + 500, name, (long long) start);
+        setProfile(expected.profiles[expected.profileCount++], name, start, start + 500);
+    }
+    snprintf(body + n, sizeof(body) - n, "],\n\"tz\": \"\", \"utc\": 5.75 }");
+
+    bool ok = exchange("POST", "/config", body, res);
+    checkResponse("POST names", ok, res, 200, nullptr);
+    checkConfig("POST names", expected);
+
+    // a rule alone keeps the profiles
+    snprintf(expected.tz, sizeof(expected.tz), "%s", "CET-1CEST,M3.5.0,M10.5.0/3");
+    ok = exchange("POST", "/config", "{\"tz\":\"CET-1CEST,M3.5.0,M10.5.0/3\"}", res);
+    checkResponse("POST tz", ok, res, 200, nullptr);
+    checkConfig("POST tz", expected);
+
+    formatConfig(body, sizeof(body), expected);
+    ok = exchange("POST", "/config", body, res);
+    checkResponse("POST formatted", ok, res, 200, nullptr);
+    checkConfig("POST formatted", expected);
+    printf("round trip: %u profiles, names", expected.profileCount);
+
+    for (uint8_t i = 0; i < expected.profileCount; i++) {
+        printf(" \"%s\"", expected.profiles[i].name);
+    }
+    printf("\n");
+}
+
+// every /status number at its widest, the longest strings and a full profile table;
+// any piece cut by HTTP_BUFFER_SIZE leaves invalid JSON
+void checkWorstCase() {
+    char local[DISPLAY_BUFFER_SIZE];
+    char zoneName[TZ_NAME_SIZE];
+    char name[PROFILE_NAME_SIZE];
+    configuration saved = config;
+    textOut out = {{}, 0};
+
+    memset(local, '9', sizeof(local) - 1);
+    local[sizeof(local) - 1] = '\0';
+    memset(zoneName, 'Z', sizeof(zoneName) - 1);
+    zoneName[sizeof(zoneName) - 1] = '\0';
+    memset(name, 'N', sizeof(name) - 1);
+    name[sizeof(name) - 1] = '\0';
+
+    config.utcOffset = UTC_MIN;
+    memset(config.tz, 'T', sizeof(config.tz) - 1);
+    config.tz[sizeof(config.tz) - 1] = '\0';
+
+    for (uint8_t i = 0; i < PROFILE_MAX; i++) {
+        setProfile(config.profiles[i], name, INT64_MIN, INT64_MAX);
+    }
+    config.profileCount = PROFILE_MAX;
+
+    apiStatus s = {
+        INT64_MIN, local, zoneName, "xxxxxxxx", INT32_MIN,
+        "a.long.ntp.server.name.that.bypasses.the.format.buffer.example.org", UINT32_MAX, INT32_MIN,
+        {255, 255, 255, 255}, INT32_MIN, INT32_MIN,
+        "xxxxxxxx", UINT32_MAX, UINT64_MAX, UINT64_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX,
+        UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT64_MAX,
+    };
+    apiServeStatus(out, httpBuffer, HTTP_BUFFER_SIZE, configBuffer, s, config);
+    const char* body = strstr(out.text, "\r\n\r\n");
+
+    if (!body || !jsonValid(body + 4)) {
+        hostFail("worst case /status is not valid JSON: %s", out.text);
+    }
+    printf("worst case: %zu bytes of /status\n", out.size);
+
+    out.size = 0;
+    apiServeConfig(out, httpBuffer, HTTP_BUFFER_SIZE, configBuffer, config);
+    body = strstr(out.text, "\r\n\r\n");
+
+    if (!body || !jsonValid(body + 4)) {
+        hostFail("worst case /config is not valid JSON: %s", out.text);
+    }
+    config = saved;
+}
+
+/*** main ***/
+
+int main(int argc, char** argv) {
+    hostParseOptions(argc, argv, optionTable);
+
+    if (options.budget == 0) {
+        hostUsage(argv[0], optionTable);
+    }
+    // initConfig() defaults
+    config.utcOffset = UTC_OFFSET_DEFAULT;
+    snprintf(config.tz, sizeof(config.tz), "%s", TZ_DEFAULT);
+    setProfile(config.profiles[0], PROFILE_NAME_DEFAULT, BIRTH_DEFAULT, DEATH_DEFAULT);
+    config.profileCount = 1;
+    compileZone();
+
+    server = openServer(options.port);
+    bootMs = hostMs();
+
+    if (options.serve) {
+        printf("Listening on 127.0.0.1:%u, %u bytes per %u ms tick\n", options.port, options.budget, options.tickMs);
+        fflush(stdout);
+
+        while (true) {
+            updateHttp(hostMs());
+            fflush(stdout);
+            usleep(options.tickMs * 1000);
+        }
+    }
+    checkRoutes();
+    checkRoundTrip();
+    checkWorstCase();
+
+    printf("served %u requests, %u bytes per %u ms tick\n", requests, options.budget, options.tickMs);
+    return hostResult();
+}
@@ -0,0 +1,162 @@
+// Host test of the panel backend against the controller mocks:
+//
+//   make panel-test PANEL_ARGS="--rounds 500 --seed 7"
+//
+// For each controller and panel height, random pixel/line/fill operations are drawn
+// into panel<> and into a plain bool grid, the panel is flushed through the mock bus
+// and every glass pixel decoded from the emulated GDDRAM is compared with the grid.
+// RAM outside the glass must stay blank and each flush must cost the expected bus
+// transfers and bytes. Exits 1 on any mismatch.
+
+#include <random>
+#include <type_traits>
+
+#include "host.h"
+#include "panel.h"
+#include "panel_mock.h"
+
+/*** constants ***/
+
+#define TEST_OPS_PER_ROUND 40
+#define TEST_MARGIN 12 // operations may start this far off the glass
+
+/*** types ***/
+
+struct testOptions {
+    uint32_t rounds;
+    uint32_t seed;
+};
+
+/*** globals ***/
+
+testOptions options = {200, 1};
+const hostOption optionTable[] = {
+    {"--rounds", HOST_UINT, &options.rounds},
+    {"--seed", HOST_UINT, &options.seed},
+};
+
+/*** reference ***/
+
+// one pixel at a time, no page math shared with panel.h
+template <uint8_t W, uint8_t H>
+struct reference {
+    bool px[H][W];
+
+    void set(int x, int y, uint16_t color) {
+        if (x < 0 || x >= W || y < 0 || y >= H) {
+            return;
+        }
+        px[y][x] = color == INVERSE ? !px[y][x] : color == WHITE;
+    }
+
+    void fill(uint16_t color) {
+        for (int y = 0; y < H; y++) {
+            for (int x = 0; x < W; x++) {
+                set(x, y, color);
+            }
+        }
+    }
+};
+
+/*** test ***/
+
+// bytes and transfers of one flush, SSD1306 one stream, SH1106 one per page
+template <class Controller, uint8_t W, uint8_t H>
+void expectedFlush(uint32_t* transfers, uint32_t* commandBytes, uint32_t* dataBytes) {
+    bool paged = std::is_same<Controller, sh1106>::value;
+    *transfers = paged ? 2 * (H / PANEL_PAGE_BITS) : 2;
+    *commandBytes = paged ? 3 * (H / PANEL_PAGE_BITS) : 6;
+    *dataBytes = W * (H / PANEL_PAGE_BITS);
+}
+
+template <class Controller, class Mock, uint8_t W, uint8_t H>
+void run(const char* name) {
+    static panel<Controller, Mock, W, H> p;
+    static reference<W, H> ref;
+    std::mt19937 rng(options.seed);
+    auto pick = [&](int lo, int hi) { return lo + (int) (rng() % (uint32_t) (hi - lo + 1)); };
+    uint32_t ops = 0;
+
+    if (!p.begin() || !p.bus.on) {
+        hostFail("%s: not switched on by init", name);
+    }
+    memset(&ref, 0, sizeof(ref));
+
+    for (uint32_t round = 0; round < options.rounds; round++) {
+        for (uint8_t i = 0; i < TEST_OPS_PER_ROUND; i++, ops++) {
+            uint16_t color = pick(0, 9) < 5 ? WHITE : pick(0, 1) ? BLACK : INVERSE;
+            int x = pick(-TEST_MARGIN, W + TEST_MARGIN);
+            int y = pick(-TEST_MARGIN, H + TEST_MARGIN);
+            int n = pick(-2, W);
+
+            switch (pick(0, 19)) {
+                case 0:
+                    p.fill(color);
+                    ref.fill(color);
+                    break;
+                case 1: case 2: case 3: case 4: case 5: case 6:
+                    p.hline(x, y, n, color);
+                    for (int k = 0; k < n; k++) {
+                        ref.set(x + k, y, color);
+                    }
+                    break;
+                case 7: case 8: case 9: case 10: case 11: case 12:
+                    p.vline(x, y, n % (H + 1), color);
+                    for (int k = 0; k < n % (H + 1); k++) {
+                        ref.set(x, y + k, color);
+                    }
+                    break;
+                default:
+                    p.setPixel(x, y, color);
+                    ref.set(x, y, color);
+                    break;
+            }
+        }
+        mockBusStats before = p.bus.stats;
+        p.flush();
+
+        uint32_t transfers, commandBytes, dataBytes;
+        expectedFlush<Controller, W, H>(&transfers, &commandBytes, &dataBytes);
+
+        if (p.bus.stats.transfers - before.transfers != transfers
+            || p.bus.stats.commandBytes - before.commandBytes != commandBytes
+            || p.bus.stats.dataBytes - before.dataBytes != dataBytes) {
+            hostFail("%s: round %u: flush cost %u transfers, %u command and %u data bytes", name, round,
+                p.bus.stats.transfers - before.transfers, p.bus.stats.commandBytes - before.commandBytes,
+                p.bus.stats.dataBytes - before.dataBytes);
+        }
+        for (int y = 0; y < H; y++) {
+            for (int x = 0; x < W; x++) {
+                if (p.bus.pixel(x, y) != ref.px[y][x]) {
+                    hostFail("%s: round %u: pixel %d,%d is %d, expected %d", name, round, x, y, p.bus.pixel(x, y), ref.px[y][x]);
+                }
+            }
+        }
+    }
+
+    // RAM the glass does not show must never be written
+    for (int page = 0; page < Mock::PAGES; page++) {
+        for (int col = 0; col < Mock::COLUMNS; col++) {
+            bool glass = page < H / PANEL_PAGE_BITS && col >= Mock::GLASS_OFFSET && col < Mock::GLASS_OFFSET + W;
+
+            if (!glass && p.bus.ram[page][col]) {
+                hostFail("%s: RAM page %d column %d outside the glass written", name, page, col);
+            }
+        }
+    }
+    printf("%-12s %u rounds, %u ops, %u flushes, %u data bytes\n", name, options.rounds, ops,
+        options.rounds, p.bus.stats.dataBytes);
+}
+
+/*** main ***/
+
+int main(int argc, char** argv) {
+    hostParseOptions(argc, argv, optionTable);
+
+    run<ssd1306, ssd1306Mock, 128, 64>("ssd1306 64");
+    run<ssd1306, ssd1306Mock, 128, 32>("ssd1306 32");
+    run<sh1106, sh1106Mock, 128, 64>("sh1106 64");
+    run<sh1106, sh1106Mock, 128, 32>("sh1106 32");
+
+    return hostResult();
+}
@@ -0,0 +1,251 @@
+// Host harness for the SNTP server code, serves sntp.h from a UDP socket:
+//
+//   make sntp-host                          # self test with a local client, exits 1 on failure
+//   make sntp-host SNTP_ARGS="--serve"      # keep serving, then: sntp -d 127.0.0.1:11123
+//
+// Mirrors serveSntp() in main.cpp: the reply template is built once as after an
+// upstream sync, each request only patches in the client fields and our timestamps,
+// at most SNTP_PACKETS_PER_TICK datagrams are handled per --tick ms pass. The self
+// test sends requests from a second socket and checks the replies with the same
+// sntpReplyTime() the firmware's NTP client uses, then marks the template unsynced
+// and checks that clients reject it.
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "host.h"
+#include "sntp.h"
+
+/*** constants ***/
+
+#define HOST_STRATUM 2       // as if synced to a stratum 1 upstream
+#define HOST_RTT_MS 20       // upstream round trip folded into root delay
+#define HOST_MAX_ERROR_MS 50 // local client vs host clock
+#define HOST_WAIT_MS 500     // per request in the self test
+
+/*** types ***/
+
+struct sntpHostOptions {
+    uint32_t port;
+    uint32_t count; // self test requests
+    uint32_t tickMs;
+    bool serve;
+};
+
+struct hostServer {
+    int fd;
+    uint8_t tmpl[SNTP_PACKET_SIZE];
+    uint8_t request[SNTP_PACKET_SIZE];
+    uint8_t reply[SNTP_PACKET_SIZE];
+    uint32_t served;
+    uint32_t ignored;
+};
+
+/*** globals ***/
+
+sntpHostOptions options = {11123, 20, 1, false};
+const hostOption optionTable[] = {
+    {"--port", HOST_UINT, &options.port},
+    {"--count", HOST_UINT, &options.count},
+    {"--tick", HOST_UINT, &options.tickMs},
+    {"--serve", HOST_FLAG, &options.serve},
+};
+hostServer server = {-1, {}, {}, {}, 0, 0};
+
+/*** helpers ***/
+
+uint64_t hostUtcMs() {
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int openSocket(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (fd < 0 || bind(fd, (sockaddr*) &addr, sizeof(addr))) {
+        perror("Error: bind failed");
+        exit(1);
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    return fd;
+}
+
+/*** server ***/
+
+// what updateSntpTemplate() does after an upstream sync
+void buildTemplate() {
+    uint8_t refId[4] = {127, 0, 0, 1};
+    sntpBuildTemplate(server.tmpl, HOST_STRATUM, refId, sntpShortFromMs(HOST_RTT_MS),
+        sntpShortFromMs(HOST_RTT_MS / 2), sntpFromUnixMs(hostUtcMs()));
+}
+
+void updateServer() {
+    for (uint8_t i = 0; i < SNTP_PACKETS_PER_TICK; i++) {
+        sockaddr_in from;
+        socklen_t fromSize = sizeof(from);
+        ssize_t size = recvfrom(server.fd, server.request, SNTP_PACKET_SIZE, MSG_TRUNC,
+            (sockaddr*) &from, &fromSize);
+
+        if (size < 0) {
+            return;
+        }
+        if (!sntpIsRequest(server.request, size)) {
+            server.ignored++;
+            continue;
+        }
+        sntpTimestamp t = sntpFromUnixMs(hostUtcMs());
+        sntpReply(server.reply, server.tmpl, server.request, t, t);
+        sendto(server.fd, server.reply, SNTP_PACKET_SIZE, 0, (sockaddr*) &from, fromSize);
+        server.served++;
+    }
+}
+
+/*** client ***/
+
+// request like sendNtpPacket() with a transmit timestamp so the origin echo can be checked
+bool exchange(int fd, const uint8_t* request, size_t size, uint8_t* reply, uint32_t* rttMs) {
+    sockaddr_in to = {};
+    to.sin_family = AF_INET;
+    to.sin_port = htons(options.port);
+    to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    uint64_t sentMs = hostUtcMs();
+    sendto(fd, request, size, 0, (sockaddr*) &to, sizeof(to));
+
+    while (hostUtcMs() - sentMs < HOST_WAIT_MS) {
+        updateServer();
+
+        if (recv(fd, reply, SNTP_PACKET_SIZE, 0) == SNTP_PACKET_SIZE) {
+            *rttMs = hostUtcMs() - sentMs;
+            return true;
+        }
+        usleep(options.tickMs * 1000);
+    }
+    return false;
+}
+
+void buildRequest(uint8_t* request, uint8_t version) {
+    memset(request, 0, SNTP_PACKET_SIZE);
+    request[0] = (version << 3) | SNTP_MODE_CLIENT;
+    request[2] = 6; // poll
+    sntpWriteTimestamp(request + SNTP_TX_TIME, sntpFromUnixMs(hostUtcMs()));
+}
+
+void checkSynced(int fd, uint32_t n) {
+    uint8_t request[SNTP_PACKET_SIZE];
+    uint8_t reply[SNTP_PACKET_SIZE];
+    uint32_t rttMs, maxRttMs = 0;
+    uint64_t maxErrorMs = 0;
+
+    for (uint32_t i = 0; i < n; i++) {
+        uint8_t version = 3 + i % 2;
+        buildRequest(request, version);
+
+        if (!exchange(fd, request, SNTP_PACKET_SIZE, reply, &rttMs)) {
+            hostFail("request %u: no reply", i);
+            continue;
+        }
+        uint64_t utcMs;
+        uint64_t nowMs = hostUtcMs();
+
+        if (!sntpReplyTime(reply, rttMs, &utcMs)) {
+            hostFail("request %u: reply rejected (LI %u, mode %u, stratum %u)", i, sntpLeap(reply),
+                sntpMode(reply), reply[1]);
+            continue;
+        }
+        uint64_t errorMs = utcMs > nowMs ? utcMs - nowMs : nowMs - utcMs;
+
+        if (errorMs > HOST_MAX_ERROR_MS) {
+            hostFail("request %u: time off by %llu ms", i, (unsigned long long) errorMs);
+        }
+        if (((reply[0] >> 3) & 0x07) != version || reply[2] != request[2]) {
+            hostFail("request %u: version/poll not echoed", i);
+        }
+        if (memcmp(reply + SNTP_ORIGIN_TIME, request + SNTP_TX_TIME, 8) != 0) {
+            hostFail("request %u: origin is not the request transmit time", i);
+        }
+        if (reply[1] != HOST_STRATUM || sntpReadWord(reply + SNTP_ROOT_DELAY) != sntpShortFromMs(HOST_RTT_MS)) {
+            hostFail("request %u: template fields lost", i);
+        }
+        maxErrorMs = errorMs > maxErrorMs ? errorMs : maxErrorMs;
+        maxRttMs = rttMs > maxRttMs ? rttMs : maxRttMs;
+    }
+    printf("synced: %u requests, max error %llu ms, max rtt %u ms\n", n, (unsigned long long) maxErrorMs, maxRttMs);
+}
+
+// server replies and short packets get no answer, they would loop between two servers
+void checkIgnored(int fd) {
+    uint8_t request[SNTP_PACKET_SIZE];
+    uint8_t reply[SNTP_PACKET_SIZE];
+    uint32_t rttMs;
+    uint32_t ignored = server.ignored;
+
+    buildRequest(request, 4);
+    request[0] = (4 << 3) | SNTP_MODE_SERVER;
+
+    if (exchange(fd, request, SNTP_PACKET_SIZE, reply, &rttMs)) {
+        hostFail("answered a server mode packet");
+    }
+    buildRequest(request, 4);
+
+    if (exchange(fd, request, SNTP_PACKET_SIZE - 1, reply, &rttMs)) {
+        hostFail("answered a short packet");
+    }
+    if (server.ignored != ignored + 2) {
+        hostFail("ignored %u packets, expected 2", server.ignored - ignored);
+    }
+}
+
+// past SNTP_MAX_AGE_SECS the firmware marks the template, clients must drop the reply
+void checkUnsynced(int fd) {
+    uint8_t request[SNTP_PACKET_SIZE];
+    uint8_t reply[SNTP_PACKET_SIZE];
+    uint32_t rttMs;
+    uint64_t utcMs;
+
+    sntpMarkUnsynced(server.tmpl);
+    buildRequest(request, 4);
+
+    if (!exchange(fd, request, SNTP_PACKET_SIZE, reply, &rttMs)) {
+        hostFail("unsynced: no reply");
+    } else if (sntpReplyTime(reply, rttMs, &utcMs)) {
+        hostFail("unsynced: reply accepted");
+    }
+    buildTemplate();
+}
+
+/*** main ***/
+
+int main(int argc, char** argv) {
+    hostParseOptions(argc, argv, optionTable);
+    server.fd = openSocket(options.port);
+    buildTemplate();
+
+    if (options.serve) {
+        printf("Serving SNTP on 127.0.0.1:%u\n", options.port);
+        fflush(stdout);
+
+        while (true) {
+            updateServer();
+            usleep(options.tickMs * 1000);
+        }
+    }
+    int client = openSocket(0);
+
+    checkSynced(client, options.count);
+    checkIgnored(client);
+    checkUnsynced(client);
+
+    printf("served %u, ignored %u\n", server.served, server.ignored);
+    return hostResult();
+}
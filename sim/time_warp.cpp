@@ -0,0 +1,536 @@
+// Accelerated time-warp simulation of the clock and page math, runs on host:
+//
+//   make sim SIM_ARGS="--years 60 --drift 80 --jitter 40 --loss 5"
+//
+// A discrete-event loop advances true UTC and a drifting millis() (wrapping at 2^32),
+// answers NTP requests from an ideal server with configurable delay, jitter and loss,
+// and drives the same clock.h/sntp.h/tz.h code as the firmware. Device wake-ups are
+// scheduled in millis() time like loop() would see them. At every event the clock
+// error, local time (against glibc with the same TZ rule) and the frame and page text
+// of pages.h are checked: clock and date strings against strftime(), percent/hours
+// against an exact 128 bit (fixed point) or long double (float printf) computation,
+// date editor steps against timegm() normalization. Exits 1 on any failed check.
+
+#include <chrono>
+#include <math.h>
+#include <queue>
+#include <random>
+#include <time.h>
+#include <vector>
+
+#include "config.h"
+#include "clock.h"
+#include "host.h"
+#include "pages.h"
+#include "sntp.h"
+#include "tz.h"
+
+/*** constants ***/
+
+#define SIM_BOUNDARY_MS 1000 // boundaries are checked this far before/at/after
+#define SIM_DATE_STEPS 20000 // random dates per date editor field and direction
+#define SIM_TEXT_EVERY 16    // page text checked at every Nth event and all boundaries
+
+/*** types ***/
+
+struct simOptions {
+    int32_t startYear;
+    int32_t years;
+    uint32_t stepMs;    // periodic check interval
+    double driftPpm;    // crystal error, positive => millis() runs fast
+    uint32_t delayMs;   // one way network delay
+    uint32_t jitterMs;  // extra one way delay, uniform 0..jitter
+    double lossPct;     // per direction
+    uint32_t seed;
+    const char* tz;
+    uint32_t maxErrorMs;
+};
+
+enum eventType {
+    EVENT_CHECK,    // periodic check
+    EVENT_BOUNDARY, // check around a DST transition or new year, page text always checked
+    EVENT_WAKE,  // device timer due (sync or timeout)
+    EVENT_REPLY, // NTP reply arrives
+};
+
+struct event {
+    uint64_t atMs; // true UTC
+    eventType type;
+    uint8_t packet[SNTP_PACKET_SIZE];
+
+    bool operator>(const event& e) const {
+        return atMs > e.atMs;
+    }
+};
+
+// mirror of the firmware's ntpClient/clock state machine
+struct device {
+    uint64_t bootMs;
+    int64_t driftPpb;
+    clockState clock;
+    tzInfo zone;
+    timeFrame frame;
+    countdown life; // default profile
+    uint32_t sentMs;
+    uint32_t nextMs;
+    bool pending;
+    bool requested;
+};
+
+struct simStats {
+    uint64_t events;
+    uint32_t requests;
+    uint32_t lost;
+    uint32_t timeouts;
+    uint32_t syncs;
+    uint32_t driftEstimates;
+    uint32_t transitions;
+    uint32_t yearBoundaries;
+    uint32_t millisWraps;
+    uint64_t maxErrorMs;
+    double sumErrorMs;
+    uint64_t errorSamples;
+};
+
+/*** globals ***/
+
+simOptions opt = {2020, 60, 60000, 50.0, 20, 30, 2.0, 1, TZ_DEFAULT, 500};
+const hostOption optionTable[] = {
+    {"--start", HOST_INT, &opt.startYear},
+    {"--years", HOST_INT, &opt.years},
+    {"--step", HOST_UINT, &opt.stepMs},
+    {"--drift", HOST_DOUBLE, &opt.driftPpm},
+    {"--delay", HOST_UINT, &opt.delayMs},
+    {"--jitter", HOST_UINT, &opt.jitterMs},
+    {"--loss", HOST_DOUBLE, &opt.lossPct},
+    {"--seed", HOST_UINT, &opt.seed},
+    {"--tz", HOST_STRING, &opt.tz},
+    {"--max-error", HOST_UINT, &opt.maxErrorMs},
+};
+simStats stats;
+device dev;
+std::priority_queue<event, std::vector<event>, std::greater<event>> events;
+std::mt19937 rng;
+uint8_t serverTemplate[SNTP_PACKET_SIZE];
+int64_t scheduledTransition;
+int32_t scheduledYear;
+
+/*** utilities ***/
+
+// hostFail() prefixed with the true UTC of the event
+void fail(uint64_t atMs, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+void fail(uint64_t atMs, const char* format, ...) {
+    char buffer[160];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+
+    time_t t = atMs / 1000;
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    hostFail("%04d-%02d-%02d %02d:%02d:%02d.%03u UTC: %s", tm.tm_year + 1900, tm.tm_mon + 1,
+        tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, (unsigned) (atMs % 1000), buffer);
+}
+
+// Jan 1 of the year in UTC, ms
+uint64_t yearMs(int32_t y) {
+    return (uint64_t) tzYearStart(y) * 1000;
+}
+
+// true UTC -> what millis() reads on the device
+uint32_t millisAt(uint64_t trueMs) {
+    int64_t elapsed = trueMs - dev.bootMs;
+    return (uint32_t) (elapsed + elapsed * dev.driftPpb / 1000000000LL);
+}
+
+// first true UTC at which millis() has advanced by deltaMs
+uint64_t trueAfter(uint64_t trueMs, uint32_t deltaMs) {
+    return trueMs + (deltaMs * 1000000000LL + 1000000000LL + dev.driftPpb - 1) / (1000000000LL + dev.driftPpb);
+}
+
+bool chance(double pct) {
+    return std::uniform_real_distribution<double>(0, 100)(rng) < pct;
+}
+
+uint32_t networkDelay() {
+    return opt.delayMs + std::uniform_int_distribution<uint32_t>(0, opt.jitterMs)(rng);
+}
+
+void schedule(uint64_t atMs, eventType type, const uint8_t* packet = nullptr) {
+    event e;
+    e.atMs = atMs;
+    e.type = type;
+    if (packet) {
+        memcpy(e.packet, packet, SNTP_PACKET_SIZE);
+    }
+    events.push(e);
+}
+
+/*** NTP ***/
+
+// ideal stratum 1 server, replies with true time at receive
+void sendRequest(uint64_t trueMs, uint32_t ms) {
+    uint8_t request[SNTP_PACKET_SIZE] = {0};
+    request[0] = 0b11100011; // same LI/version/mode as sendNtpPacket()
+    sntpWriteTimestamp(request + SNTP_TX_TIME, sntpFromUnixMs(trueMs));
+
+    dev.pending = true;
+    dev.requested = false;
+    dev.sentMs = ms;
+    stats.requests++;
+    schedule(trueAfter(trueMs, NTP_WAIT_MS), EVENT_WAKE);
+
+    if (chance(opt.lossPct)) {
+        stats.lost++;
+        return;
+    }
+    uint64_t rxMs = trueMs + networkDelay();
+    uint8_t reply[SNTP_PACKET_SIZE];
+    sntpReply(reply, serverTemplate, request, sntpFromUnixMs(rxMs), sntpFromUnixMs(rxMs));
+
+    if (chance(opt.lossPct)) {
+        stats.lost++;
+        return;
+    }
+    schedule(rxMs + networkDelay(), EVENT_REPLY, reply);
+}
+
+void handleReply(uint64_t trueMs, uint32_t ms, const uint8_t* packet) {
+    uint64_t utcMs;
+    dev.pending = false;
+
+    if (!sntpReplyTime(packet, ms - dev.sentMs, &utcMs)) {
+        fail(trueMs, "valid reply rejected");
+        dev.nextMs = ms + NTP_RETRY_SECS * 1000UL;
+        schedule(trueAfter(trueMs, NTP_RETRY_SECS * 1000UL), EVENT_WAKE);
+        return;
+    }
+    if (clockSync(dev.clock, utcMs, ms, DRIFT_WINDOW_SECS * 1000UL)) {
+        stats.driftEstimates++;
+    }
+    stats.syncs++;
+    dev.nextMs = ms + NTP_SYNC_SECS * 1000UL;
+    schedule(trueAfter(trueMs, NTP_SYNC_SECS * 1000UL), EVENT_WAKE);
+}
+
+// updateNtp() of the firmware
+void updateDevice(uint64_t trueMs, uint32_t ms) {
+    if (dev.pending) {
+        if (ms - dev.sentMs >= NTP_WAIT_MS) {
+            stats.timeouts++;
+            dev.pending = false;
+            dev.nextMs = ms + NTP_RETRY_SECS * 1000UL;
+            schedule(trueAfter(trueMs, NTP_RETRY_SECS * 1000UL), EVENT_WAKE);
+        }
+    } else if (dev.requested || (int32_t) (ms - dev.nextMs) >= 0) {
+        sendRequest(trueMs, ms);
+    }
+    if (dev.clock.source != TIME_SOURCE_NONE) {
+        clockReanchor(dev.clock, clockRead(dev.clock, ms), ms);
+    }
+}
+
+/*** checks ***/
+
+void checkClock(uint64_t trueMs, uint64_t utcMs) {
+    uint64_t err = utcMs > trueMs ? utcMs - trueMs : trueMs - utcMs;
+
+    stats.maxErrorMs = err > stats.maxErrorMs ? err : stats.maxErrorMs;
+    stats.sumErrorMs += err;
+    stats.errorSamples++;
+
+    if (err > opt.maxErrorMs) {
+        fail(trueMs, "clock off by %llu ms (drift estimate %d ppb)", (unsigned long long) err, dev.clock.driftPpb);
+    }
+}
+
+// formatRatio() against 128 bit integer math, truncated toward zero like the long division
+void checkRatio(uint64_t trueMs, int64_t num, int64_t den, uint8_t decimals) {
+    char text[DISPLAY_BUFFER_SIZE];
+    char expected[DISPLAY_BUFFER_SIZE];
+    __int128 scale = 1;
+
+    for (uint8_t i = 0; i < decimals; i++) {
+        scale *= 10;
+    }
+    __int128 q = (__int128) num * scale / den;
+    unsigned __int128 a = q < 0 ? -q : q;
+    bool negative = (num < 0) != (den < 0) && num != 0;
+
+    snprintf(expected, DISPLAY_BUFFER_SIZE, "%s%llu", negative ? "-" : "", (unsigned long long) (a / scale));
+    if (decimals) {
+        snprintf(expected + strlen(expected), DISPLAY_BUFFER_SIZE - strlen(expected), ".%0*llu", decimals,
+            (unsigned long long) (a % scale));
+    }
+    char* end = formatRatio(text, num, den, decimals);
+
+    if (strcmp(text, expected) != 0 || end != text + strlen(text)) {
+        fail(trueMs, "formatRatio(%lld, %lld, %u) is \"%s\", expected \"%s\"", (long long) num,
+            (long long) den, decimals, text, expected);
+    }
+}
+
+// percent/hours text of a page against an independent computation
+void checkPageText(uint64_t trueMs, const char* page, const countdown& c, time_t remaining) {
+    char text[DISPLAY_BUFFER_SIZE];
+#if FEATURE_FLOAT_PRINTF
+    char* end;
+    formatPercentLeft(text, DISPLAY_BUFFER_SIZE, c, remaining);
+    long double exact = (long double) remaining * 100 / c.total;
+
+    if (fabsl(strtold(text, &end) - exact) > 1e-10L || strcmp(end, " %") != 0) {
+        fail(trueMs, "%s page shows \"%s\", expected %.12Lf", page, text, exact);
+    }
+    formatHoursLeft(text, DISPLAY_BUFFER_SIZE, remaining);
+    exact = (long double) remaining / 3600;
+
+    if (fabsl(strtold(text, &end) - exact) > 1e-6L || strcmp(end, " h") != 0) {
+        fail(trueMs, "%s page shows \"%s\", expected %.8Lf", page, text, exact);
+    }
+#else
+    char ratio[DISPLAY_BUFFER_SIZE];
+    formatPercentLeft(text, DISPLAY_BUFFER_SIZE, c, remaining);
+    formatRatio(ratio, (int64_t) remaining * 100, c.total, 10);
+
+    if (strncmp(text, ratio, strlen(ratio)) != 0 || strcmp(text + strlen(ratio), " %") != 0) {
+        fail(trueMs, "%s page shows \"%s\"", page, text);
+    }
+    formatHoursLeft(text, DISPLAY_BUFFER_SIZE, remaining);
+    formatRatio(ratio, remaining, 3600, 6);
+
+    if (strncmp(text, ratio, strlen(ratio)) != 0 || strcmp(text + strlen(ratio), " h") != 0) {
+        fail(trueMs, "%s page shows \"%s\"", page, text);
+    }
+#endif
+    // the fixed point digits, also behind the UTC offset text
+    checkRatio(trueMs, (int64_t) remaining * 100, c.total, 10);
+    checkRatio(trueMs, remaining, 3600, 6);
+}
+
+// the frame of main.cpp's updateFrame() and the pages drawn from it, against glibc
+void checkLocal(uint64_t trueMs, time_t utc, bool text) {
+    timeFrame& f = dev.frame;
+    frameUpdate(f, dev.zone, utc);
+
+    struct tm tm;
+    localtime_r(&utc, &tm);
+    bool dst = tm.tm_isdst > 0;
+    time_t local = timegm(&tm); // normalizes tm as UTC, clears tm_isdst
+
+    if (f.utc != utc || f.local != local || dev.zone.dst != dst) {
+        fail(trueMs, "local time %lld (dst %d), glibc %lld (dst %d)",
+            (long long) f.local, dev.zone.dst, (long long) local, dst);
+    }
+    if (f.year != tm.tm_year + 1900 || f.month != tm.tm_mon + 1 || f.day != tm.tm_mday
+        || f.hour != tm.tm_hour || f.minute != tm.tm_min || f.second != tm.tm_sec) {
+        fail(trueMs, "frame %04d-%02d-%02d %02d:%02d:%02d, glibc %04d-%02d-%02d %02d:%02d:%02d",
+            f.year, f.month, f.day, f.hour, f.minute, f.second,
+            tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
+    }
+    if (text) {
+        char clock[DISPLAY_BUFFER_SIZE];
+        char expected[DISPLAY_BUFFER_SIZE];
+        strftime(expected, DISPLAY_BUFFER_SIZE, "%Y-%m-%d %H:%M:%S", &tm);
+        formatClock(clock, DISPLAY_BUFFER_SIZE, f);
+
+        if (strcmp(clock, expected) != 0) {
+            fail(trueMs, "clock page \"%s\", glibc \"%s\"", clock, expected);
+        }
+    }
+
+#if FEATURE_YEAR_PAGE
+    // year page, bounds from glibc once per year
+    static int year = -1;
+    static time_t start, end;
+
+    if (tm.tm_year != year) {
+        struct tm jan1 = {};
+        jan1.tm_year = year = tm.tm_year;
+        jan1.tm_mday = 1;
+        start = timegm(&jan1);
+        jan1.tm_year++;
+        end = timegm(&jan1);
+    }
+
+    if (f.yearSpan.start != start || f.yearSpan.end != end || f.yearSpan.total != end - start
+        || f.yearRemaining != end - local) {
+        fail(trueMs, "year span %lld..%lld remaining %lld, expected %lld..%lld",
+            (long long) f.yearSpan.start, (long long) f.yearSpan.end, (long long) f.yearRemaining,
+            (long long) start, (long long) end);
+    }
+    if (text) {
+        checkPageText(trueMs, "year", f.yearSpan, end - local);
+    }
+#endif
+
+    // life page, goes negative once the default end date has passed
+    if (text) {
+        checkPageText(trueMs, "life", dev.life, (time_t) DEATH_DEFAULT - local);
+    }
+}
+
+// extra checks around the next DST transition and new year, as the device sees them
+void scheduleBoundaries(uint64_t trueMs) {
+    if (dev.zone.hasDst && dev.zone.nextTransition != scheduledTransition) {
+        scheduledTransition = dev.zone.nextTransition;
+        uint64_t at = (uint64_t) scheduledTransition * 1000;
+        schedule(at - SIM_BOUNDARY_MS, EVENT_BOUNDARY);
+        schedule(at, EVENT_BOUNDARY);
+        schedule(at + SIM_BOUNDARY_MS, EVENT_BOUNDARY);
+        stats.transitions++;
+    }
+    int32_t y = tzYearOf(trueMs / 1000 + dev.zone.offset) + 1;
+
+    if (y != scheduledYear) {
+        scheduledYear = y;
+        uint64_t at = yearMs(y) - (int64_t) dev.zone.offset * 1000;
+        schedule(at - SIM_BOUNDARY_MS, EVENT_BOUNDARY);
+        schedule(at, EVENT_BOUNDARY);
+        schedule(at + SIM_BOUNDARY_MS, EVENT_BOUNDARY);
+        stats.yearBoundaries++;
+    }
+}
+
+void checkDates() {
+    const time_t dates[] = {BIRTH_DEFAULT, DEATH_DEFAULT, 0x7FFFFFFF, 0x80000000LL, 2085978496LL /* NTP era 1 */};
+
+    for (time_t t : dates) {
+        char text[DISPLAY_BUFFER_SIZE];
+        char expected[DISPLAY_BUFFER_SIZE];
+        struct tm tm;
+        gmtime_r(&t, &tm);
+        strftime(expected, DISPLAY_BUFFER_SIZE, "%Y-%m-%d", &tm);
+        formatDate(text, DISPLAY_BUFFER_SIZE, t);
+
+        if (strcmp(text, expected) != 0) {
+            fail(t * 1000ULL, "date page \"%s\", glibc \"%s\"", text, expected);
+        }
+        if (sntpToUnixMs(sntpFromUnixMs(t * 1000ULL)) != t * 1000ULL) {
+            fail(t * 1000ULL, "NTP timestamp round trip of %lld", (long long) t);
+        }
+    }
+
+    // ratios the pages reach only at the ends of a span, both signs
+    const int64_t nums[] = {0, 1, -1, 99, -99, 100, -100, 3599, -3600, INT64_C(1) << 40, -(INT64_C(1) << 40)};
+    const int64_t dens[] = {1, 3, 7, 3600, -3600, 31536000, 31622400, 2524608000LL};
+
+    for (int64_t n : nums) {
+        for (int64_t d : dens) {
+            checkRatio(0, n, d, 10);
+            checkRatio(0, n, d, 6);
+            checkRatio(0, n, d, 0);
+        }
+    }
+}
+
+// stepDate() of the date editor against timegm(), day clamped to the target month
+void checkDateSteps() {
+    std::uniform_int_distribution<int64_t> pick(tzYearStart(1900), tzYearStart(2100));
+
+    for (uint32_t i = 0; i < SIM_DATE_STEPS; i++) {
+        time_t t = pick(rng);
+
+        for (uint8_t field = 0; field < 3; field++) {
+            for (int8_t dir = -1; dir <= 1; dir += 2) {
+                struct tm tm;
+                gmtime_r(&t, &tm);
+
+                if (field == 2) {
+                    tm.tm_mday += dir;
+                } else {
+                    tm.tm_year += field == 0 ? dir : 0;
+                    tm.tm_mon += field == 1 ? dir : 0;
+                    struct tm last = tm;
+                    last.tm_mon++;
+                    last.tm_mday = 0;
+                    timegm(&last); // day 0 of the next month, normalized to the last day of this one
+                    tm.tm_mday = tm.tm_mday < last.tm_mday ? tm.tm_mday : last.tm_mday;
+                }
+                time_t expected = timegm(&tm);
+                time_t stepped = stepDate(t, field, dir);
+
+                if (stepped != expected) {
+                    fail(t * 1000ULL, "date step field %u dir %d gives %lld, expected %lld", field, dir,
+                        (long long) stepped, (long long) expected);
+                }
+            }
+        }
+    }
+}
+
+/*** main ***/
+
+int main(int argc, char** argv) {
+    hostParseOptions(argc, argv, optionTable);
+
+    if (opt.years <= 0 || opt.stepMs == 0) {
+        hostUsage(argv[0], optionTable);
+    }
+    rng.seed(opt.seed);
+
+    if (!tzCompile(dev.zone, opt.tz)) {
+        printf("error: invalid TZ rule %s\n", opt.tz);
+        return 2;
+    }
+    setenv("TZ", opt.tz, 1);
+    tzset();
+
+    const uint8_t refId[4] = {'G', 'P', 'S', 0};
+    uint64_t startMs = yearMs(opt.startYear);
+    uint64_t endMs = yearMs(opt.startYear + opt.years);
+    sntpBuildTemplate(serverTemplate, 1, refId, 0, 0, sntpFromUnixMs(startMs));
+
+    dev.bootMs = startMs;
+    dev.driftPpb = (int64_t) (opt.driftPpm * 1000);
+    dev.requested = true;
+    dev.life = {};
+    dev.life.start = BIRTH_DEFAULT;
+    dev.life.end = DEATH_DEFAULT;
+    updateCountdown(dev.life);
+    scheduledTransition = -1;
+    checkDates();
+    checkDateSteps();
+
+    auto wallStart = std::chrono::steady_clock::now();
+    uint32_t prevMs = 0;
+
+    for (uint64_t at = startMs; at < endMs; at += opt.stepMs) {
+        schedule(at, EVENT_CHECK);
+
+        while (!events.empty() && events.top().atMs <= at) {
+            event e = events.top();
+            events.pop();
+            uint32_t ms = millisAt(e.atMs);
+            stats.events++;
+            stats.millisWraps += ms < prevMs;
+            prevMs = ms;
+
+            if (e.type == EVENT_REPLY && dev.pending) {
+                handleReply(e.atMs, ms, e.packet);
+            }
+            updateDevice(e.atMs, ms);
+
+            if (dev.clock.source == TIME_SOURCE_NTP) {
+                uint64_t utcMs = clockRead(dev.clock, ms);
+                checkClock(e.atMs, utcMs);
+                checkLocal(e.atMs, utcMs / 1000, e.type == EVENT_BOUNDARY || stats.events % SIM_TEXT_EVERY == 0);
+                scheduleBoundaries(e.atMs);
+            }
+        }
+    }
+    double wallSecs = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    double days = (endMs - startMs) / 86400000.0;
+
+    printf("simulated %d..%d (%.0f days), %llu events in %.2f s, %.0f days/s\n",
+        opt.startYear, opt.startYear + opt.years, days, (unsigned long long) stats.events, wallSecs,
+        days / (wallSecs > 0 ? wallSecs : 1e-9));
+    printf("ntp: %u requests, %u lost, %u timeouts, %u syncs, %u drift estimates\n",
+        stats.requests, stats.lost, stats.timeouts, stats.syncs, stats.driftEstimates);
+    printf("clock: drift %lld ppb, estimate %d ppb, error max %llu ms, mean %.1f ms, %u millis() wraps\n",
+        (long long) dev.driftPpb, dev.clock.driftPpb, (unsigned long long) stats.maxErrorMs,
+        stats.errorSamples ? stats.sumErrorMs / stats.errorSamples : 0.0, stats.millisWraps);
+    printf("checked: %u DST transitions, %u year boundaries (%s)\n", stats.transitions, stats.yearBoundaries, opt.tz);
+    return hostResult();
+}
@@ -1,61 +1,93 @@
-#include <Adafruit_GFX.h>
-#include <Adafruit_SSD1306.h>
 #include <Arduino.h>
-#include <ArduinoJson.h>
 #include <ESP8266WiFi.h>
 #include <LittleFS.h>
 #include <limits.h>
 #include <memory.h>
+#include <stdarg.h>
 #include <SPI.h>
-#include <TimeLib.h>
 #include <WiFiUdp.h>
 #include <Wire.h>
 
+extern "C" {
+#include <user_interface.h>
+}
+
 #include "config.h"
+#include "display.h"
+#if FEATURE_ARDUINOJSON
+#include <ArduinoJson.h>
+#endif
+#if FEATURE_HOURGLASS
 #include "hourglass.h"
+#endif
+#include "api.h"
+#include "clock.h"
+#include "http.h"
+#include "pages.h"
+#include "settings.h"
+#include "sntp.h"
+#include "tz.h"
 
 /*** constants ***/
 
-#define DISPLAY_BUFFER_SIZE 32
-#define CONFIG_BUFFER_SIZE 64
+#define LOG_BUFFER_SIZE 96 // one serial log line, longer ones are cut
+#define CONFIG_SAVE_DELAY_MS 2000
 
-#define NTP_PACKET_SIZE 48
+#define NTP_PACKET_SIZE SNTP_PACKET_SIZE
 #define NTP_PORT 123
 
-#define EDIT_LINE_Y DISPLAY_HEIGHT - 24
-#define DISPLAY_PAD 4
+#define RTC_ANCHOR_OFFSET 0          // RTC user memory block of time anchor
+#define RTC_WIFI_OFFSET 8            // RTC user memory block of WiFi cache
+#define TIME_ANCHOR_MAGIC 0x4d4d5431 // "MMT1"
+#define WIFI_CACHE_MAGIC 0x4d4d5731  // "MMW1"
+#define RTC_RESTORE_MAX_MS 10000     // larger gap => RTC counter was reset too
 
-#define UTC_STEP 0.25f
-#define UTC_MIN -12.0f
-#define UTC_MAX 14.0f
+#define HEAP_MONITOR_MS 1000
 
-// https://www.unixtimestamp.com/index.php
-#define UNIX_SECS_PER_DAY   86400
-#define UNIX_SECS_PER_MONTH 2629743  // 30.44 days
-#define UNIX_SECS_PER_YEAR  31556926 // 365.24 days
+#if RADIO_SLEEP == RADIO_SLEEP_FORCED && (FEATURE_HTTP || FEATURE_SNTP_SERVER)
+#error "RADIO_SLEEP_FORCED turns the radio off between syncs, set FEATURE_HTTP and FEATURE_SNTP_SERVER to 0"
+#endif
 
-#define CONFIG_JSON_CAPACITY JSON_OBJECT_SIZE(3) // 1 object with 3 members
+// layout scales with panel height, matches original 128x64 positions
+#define EDIT_LINE_Y (DISPLAY_HEIGHT / 2 + 8)
+#define PERCENT_LINE_Y (DISPLAY_HEIGHT / 2 - 2)
+#define HOURS_LINE_Y (DISPLAY_HEIGHT - 10)
+#define DISPLAY_PAD 4
 
-const char* clockFormat = "%04d-%02d-%02d %02d:%02d:%02d"; // YYYY-MM-DD hh:mm:ss
-const char* dateFormat = "%04d-%02d-%02d";                 // YYYY-MM-DD
-const char* percentLeftFormat = "%02.10lf %%";
-const char* hoursLeftFormat = "%.6lf h";
+#define UTC_STEP 0.25f
+
+#if FEATURE_ARDUINOJSON
+// root with utc, tz, profiles (+ birth/death of old configs), array of profile objects
+#define CONFIG_JSON_CAPACITY (JSON_OBJECT_SIZE(5) + JSON_ARRAY_SIZE(PROFILE_MAX) + PROFILE_MAX * JSON_OBJECT_SIZE(3))
+#endif
 
 #define errorHalt(s) Serial.println(s); while(1) {}
 
+// IPAddress::toString() builds a heap String
+#define IP_FORMAT "%u.%u.%u.%u"
+#define IP_ARGS(ip) (ip)[0], (ip)[1], (ip)[2], (ip)[3]
+
 /*** structs/types ***/
 
 enum state {
     STATE_IDLE_TIME,  // show current date/time
+#if FEATURE_YEAR_PAGE
     STATE_IDLE_YEAR,  // show year percentage
+#endif
+#if FEATURE_LIFE_PAGE
     STATE_IDLE_LIFE,  // show life percentage
+#endif
     STATE_SHOW_UTC,   // display UTC offset setting
+#if FEATURE_LIFE_PAGE
     STATE_SHOW_BIRTH, // display current birth setting
     STATE_SHOW_DEATH, // display current death setting
+#endif
     STATE_SHOW_NTP,   // display NTP refresh screen
     STATE_SET_UTC,    // set UTC offset
+#if FEATURE_LIFE_PAGE
     STATE_SET_BIRTH,  // set birth date
     STATE_SET_DEATH,  // set estimated death date
+#endif
 };
 
 enum direction {
@@ -68,6 +100,12 @@ struct timer {
     unsigned long intervalMs;
 };
 
+// millis() wraps after 49.7 days, see updateUptime()
+struct uptimeCounter {
+    unsigned long prevMs;
+    uint64_t ms;
+};
+
 struct range {
     union {
         int imin;
@@ -79,12 +117,98 @@ struct range {
     };
 };
 
-struct configuration {
-    float utcOffset;
-    time_t birth;
-    time_t death;
+// persisted to RTC user memory every second and to flash every TIME_FS_SAVE_SECS
+struct timeAnchor {
+    uint32_t magic;
+    uint32_t utc;
+    uint32_t utcMs;
+    uint32_t rtcTicks; // RTC counter at save
+    int32_t driftPpb;
+    uint32_t checksum;
+};
+
+enum wifiState {
+    WIFI_STATE_IDLE,      // not started
+    WIFI_STATE_FAST,      // joining cached BSSID/channel
+    WIFI_STATE_SCAN,      // joining with full scan
+    WIFI_STATE_CONNECTED,
+    WIFI_STATE_OFF,       // radio in forced sleep until the next sync, see updateRadio()
 };
 
+struct wifiLink {
+    wifiState state;
+    unsigned long startMs;
+};
+
+// persisted to RTC user memory, lets a reset skip scan and DNS
+struct wifiCache {
+    uint32_t magic;
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint8_t reserved;
+    uint32_t ntpIp;
+    uint32_t checksum;
+};
+
+struct ntpClient {
+    IPAddress serverIp;
+    unsigned long sentMs;
+    unsigned long nextMs;
+    bool pending;   // request in flight
+    bool requested; // sync asap
+    unsigned long syncedMs;
+    uint32_t syncs;
+};
+
+struct sntpServer {
+    uint8_t tmpl[NTP_PACKET_SIZE]; // precomputed reply, see sntpBuildTemplate()
+    uint8_t reply[NTP_PACKET_SIZE];
+    unsigned long syncedMs;
+    bool synced;
+    uint32_t served;
+};
+
+// radio accounting since boot in every RADIO_SLEEP mode, logged after each sync and
+// served in /status; only forced sleep turns the radio off, else onMs is the uptime
+struct radioPower {
+    uint64_t onMs;           // folded in by updateUptime()
+    uint64_t offMs;
+    uint32_t wakes;
+    unsigned long wakeMs;    // forced wake or sync due, 0 once synced
+    uint32_t wakeToSyncMs;   // wake/due until NTP reply of the last sync
+    uint32_t maxWakeToSyncMs;
+    uint32_t leadMs;         // forced: wake this far ahead of the sync, averaged wakeToSyncMs
+};
+
+// water marks since boot, a flat steady state means no leaks or fragmentation creep
+struct heapMonitor {
+    timer poll;
+    uint32_t minFree;
+    uint32_t minMaxBlock; // largest allocatable block
+    uint8_t maxFrag;      // percent
+};
+
+// "<name> Remaining" of each profile, centered, see updateLabels()
+struct profileLabel {
+    char text[DISPLAY_BUFFER_SIZE];
+    int16_t x;
+};
+
+#if FEATURE_HTTP
+// one client at a time, served across loop() passes
+struct httpConnection {
+    WiFiClient client;
+    httpRequest request;
+    unsigned long startMs;
+    bool active;
+};
+
+// http.h output to the current client
+struct httpClientOut {
+    void write(const uint8_t* p, size_t size);
+};
+#endif
+
 struct rotaryEncoder {
     int prevClk;
     int currClk;
@@ -97,73 +221,465 @@ struct rotaryEncoder {
 /*** globals ***/
 
 configuration config;
+profileLabel labels[PROFILE_MAX];
+timeFrame frame;
+tzInfo zone; // compiled from config, see compileZone()
 rotaryEncoder encoder;
-Adafruit_SSD1306 display(DISPLAY_WIDTH, DISPLAY_HEIGHT, &Wire, DISPLAY_RESET); // SDA,SCL
+clockState rtClock;
+wifiLink wifi;
+wifiCache wifiCached;
+ntpClient ntp;
+#if FEATURE_SNTP_SERVER
+sntpServer sntp;
+#endif
+heapMonitor heap = {{0, HEAP_MONITOR_MS}, UINT32_MAX, UINT32_MAX, 0};
+radioPower radio = {0, 0, 0, 0, 0, 0, RADIO_WAKE_LEAD_MS};
+#if DISPLAY_CONTROLLER == DISPLAY_SH1106
+oledDisplay<sh1106, DISPLAY_WIDTH, DISPLAY_HEIGHT, DISPLAY_I2C_ADDR> display;
+#else
+oledDisplay<ssd1306, DISPLAY_WIDTH, DISPLAY_HEIGHT, DISPLAY_I2C_ADDR> display;
+#endif
 
 WiFiUDP udp;
 byte packetBuffer[NTP_PACKET_SIZE];
 char displayBuffer[DISPLAY_BUFFER_SIZE];
-uint8_t utcOffset;
+char logBuffer[LOG_BUFFER_SIZE];
+char configBuffer[CONFIG_BUFFER_SIZE];
+timer configSave = {0, CONFIG_SAVE_DELAY_MS};
+bool configDirty = false;
+#if FEATURE_HTTP
+WiFiServer httpServer(HTTP_PORT);
+httpConnection http;
+char httpBuffer[HTTP_BUFFER_SIZE];
+#endif
 
 range pageRange;
-range utcRange;
+configInput configIn;       // keys of the config file or an HTTP body
+configuration editedConfig; // configIn merged over config, validated before it applies
 
-state prevState = STATE_IDLE_YEAR;
+state prevState = STATE_IDLE_TIME;
 state currState = STATE_IDLE_TIME;
 time_t prevTimeDisplayed = 0;
 
+#if FEATURE_HOURGLASS
 uint8_t hourglassIdx = 0;
+#endif
 uint8_t editIdx = 0;
+#if FEATURE_LIFE_PAGE
+uint8_t profileIdx = 0;
+timer profileRotation = {0, PROFILE_ROTATE_SECS * 1000UL};
+#endif
 
 unsigned long currMs = 0;
+uptimeCounter uptime = {0, 0};
 
 /*** utilities ***/
 
+// Print::printf() allocates for lines past 64 chars, this formats into logBuffer
+void logPrintf(const char* format, ...) __attribute__((format(printf, 1, 2)));
+
+void logPrintf(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(logBuffer, LOG_BUFFER_SIZE, format, args);
+    va_end(args);
+
+    if (n > 0) {
+        Serial.write((const uint8_t*) logBuffer, min(n, LOG_BUFFER_SIZE - 1));
+    }
+}
+
 void printTime() {
-    Serial.printf(clockFormat, year(), month(), day(), hour(), minute(), second());
-    Serial.println();
+    formatClock(displayBuffer, DISPLAY_BUFFER_SIZE, frame);
+    logPrintf("%s %s\n", displayBuffer, tzName(zone));
 }
 
-void unixTimeToDate(int unixTime, char* dateBuffer) {
-    sprintf(dateBuffer, dateFormat, year(unixTime), month(unixTime), day(unixTime));
+// FNV-1a
+uint32_t checksum(const void* data, size_t size) {
+    const uint8_t* p = (const uint8_t*) data;
+    uint32_t h = 2166136261UL;
+
+    for (size_t i = 0; i < size; i++) {
+        h = (h ^ p[i]) * 16777619UL;
+    }
+    return h;
 }
 
-void getTimeRemaining(time_t total, time_t remaining, double* percent, double* hours) {
-    *percent = (remaining / (1.0 * total) * 100);
-    *hours = remaining / (1.0 * SECS_PER_HOUR);
+void compileZone() {
+    if (config.tz[0] && tzCompile(zone, config.tz)) {
+        return;
+    }
+    if (config.tz[0]) {
+        logPrintf("Error: invalid TZ rule '%s', using fixed UTC offset\n", config.tz);
+    }
+    tzFixed(zone, config.utcOffset * PAGE_SECS_PER_HOUR);
 }
 
-int loadConfig() {
-    int result = 0;
-    char configBuffer[CONFIG_BUFFER_SIZE];
+/*** profiles ***/
 
-    File f = LittleFS.open(configPath, "r");
-    f.readBytes(configBuffer, CONFIG_BUFFER_SIZE);
+void updateLabels() {
+    int16_t x, y;
+    uint16_t w, h;
+
+    for (uint8_t i = 0; i < config.profileCount; i++) {
+        profileLabel& l = labels[i];
+        snprintf(l.text, sizeof(l.text), "%s Remaining", config.profiles[i].name);
+        display.getTextBounds(l.text, 0, 0, &x, &y, &w, &h);
+        l.x = (DISPLAY_WIDTH - w) / 2;
+    }
+}
+
+/*** frame ***/
+
+// also called after config edits so the current frame reflects them
+void updateFrame(time_t utc) {
+    frameUpdate(frame, zone, utc);
+#if FEATURE_LIFE_PAGE
+    for (uint8_t i = 0; i < config.profileCount; i++) {
+        frame.remaining[i] = config.profiles[i].span.end - frame.local;
+    }
+#endif
+}
 
+/*** config ***/
+
+// keys of json into in, mergeConfig() applies them
+int parseConfig(char* json, configInput& in) {
+#if FEATURE_ARDUINOJSON
     StaticJsonDocument<CONFIG_JSON_CAPACITY> data;
-    DeserializationError err = deserializeJson(data, configBuffer);
+    DeserializationError err = deserializeJson(data, json);
+    memset(&in, 0, sizeof(in));
 
     if (err) {
-        Serial.printf("Error: JSON deserialize failed with code");
-        Serial.println(err.f_str());
-        result = -1;
-    } else {
-        config.utcOffset = data["utc"];
-        config.birth = data["birth"];
-        config.death = data["death"];
+        logPrintf("Error: JSON deserialize failed with code %s\n", err.c_str());
+        return -1;
     }
-    f.close();
-
-    return result;
+    in.hasUtc = data.containsKey("utc");
+    in.utc = data["utc"];
+    in.hasTz = data.containsKey("tz");
+    strlcpy(in.tz, data["tz"] | "", sizeof(in.tz));
+    in.hasBirth = data.containsKey("birth");
+    in.birth = data["birth"];
+    in.hasDeath = data.containsKey("death");
+    in.death = data["death"];
+
+    JsonArray profiles = data["profiles"];
+    in.hasProfiles = !profiles.isNull();
+
+    for (JsonObject p : profiles) {
+        if (in.profileCount == PROFILE_MAX) {
+            break;
+        }
+        setProfile(in.profiles[in.profileCount++], p["name"] | "", p["start"], p["end"]);
+    }
+    return 0;
+#else
+    if (readConfig(json, in)) {
+        Serial.println("Error: config is not a JSON object");
+        return -1;
+    }
+    return 0;
+#endif
 }
 
 void saveConfig() {
     Serial.println("Saving config");
+    int n = formatConfig(configBuffer, CONFIG_BUFFER_SIZE, config);
+
+    if (n < 0) {
+        Serial.println("Error: config does not fit the buffer, not saved");
+        return;
+    }
     File f = LittleFS.open(configPath, "w");
-    f.printf("{\"utc\":%.2f,\"birth\":%lld,\"death\":%lld}", config.utcOffset, config.birth, config.death);
+    f.write((const uint8_t*) configBuffer, n);
     f.close();
 }
 
+int loadConfig() {
+    memset(configBuffer, 0, CONFIG_BUFFER_SIZE);
+
+    File f = LittleFS.open(configPath, "r");
+    f.readBytes(configBuffer, CONFIG_BUFFER_SIZE - 1);
+    f.close();
+
+    // merged over the defaults in config, which stay when the file is broken
+    const char* err = parseConfig(configBuffer, configIn) ? "invalid JSON" : nullptr;
+
+    if (!err) {
+        editedConfig = config;
+        mergeConfig(editedConfig, configIn);
+
+        // life page always has a profile to show
+        if (editedConfig.profileCount == 0) {
+            setProfile(editedConfig.profiles[0], PROFILE_NAME_DEFAULT, BIRTH_DEFAULT, DEATH_DEFAULT);
+            editedConfig.profileCount = 1;
+        }
+        err = validateConfig(editedConfig);
+    }
+    if (err) {
+        logPrintf("Error: config file rejected (%s), using defaults\n", err);
+        return -1;
+    }
+    config = editedConfig;
+    return 0;
+}
+
+// edits are written once they settle, a burst of them costs one flash write
+void requestSaveConfig() {
+    configDirty = true;
+    configSave.prevMs = currMs;
+}
+
+void updateConfigSave() {
+    if (!configDirty || (currMs - configSave.prevMs) < configSave.intervalMs) {
+        return;
+    }
+#if FEATURE_HTTP
+    if (http.active) {
+        return; // request body is being received into configBuffer
+    }
+#endif
+    configDirty = false;
+    saveConfig();
+}
+
+/*** clock ***/
+
+uint64_t clockUtcMs() {
+    return clockRead(rtClock, millis());
+}
+
+void saveTimeAnchor(uint64_t utcMs) {
+    timeAnchor a;
+    a.magic = TIME_ANCHOR_MAGIC;
+    a.utc = utcMs / 1000;
+    a.utcMs = utcMs % 1000;
+    a.rtcTicks = system_get_rtc_time();
+    a.driftPpb = rtClock.driftPpb;
+    a.checksum = checksum(&a, offsetof(timeAnchor, checksum));
+
+    ESP.rtcUserMemoryWrite(RTC_ANCHOR_OFFSET, (uint32_t*) &a, sizeof(a));
+
+    if (!rtClock.fsSaved || (currMs - rtClock.fsSavedMs) >= TIME_FS_SAVE_SECS * 1000UL) {
+        File f = LittleFS.open(timePath, "w");
+        f.write((const uint8_t*) &a, sizeof(a));
+        f.close();
+        rtClock.fsSaved = true;
+        rtClock.fsSavedMs = currMs;
+    }
+}
+
+timeSource loadTimeAnchor(timeAnchor& a, uint64_t& elapsedMs) {
+    if (ESP.rtcUserMemoryRead(RTC_ANCHOR_OFFSET, (uint32_t*) &a, sizeof(a))
+            && a.magic == TIME_ANCHOR_MAGIC && a.checksum == checksum(&a, offsetof(timeAnchor, checksum))) {
+        // RTC counter keeps running across soft resets, 32-bit wrap is handled by unsigned math
+        uint64_t us = ((uint64_t) (system_get_rtc_time() - a.rtcTicks) * system_rtc_clock_cali_proc()) >> 12;
+        elapsedMs = us / 1000;
+
+        if (elapsedMs > RTC_RESTORE_MAX_MS) {
+            elapsedMs = millis(); // counter reset with chip, only boot time is known
+        }
+        return TIME_SOURCE_RTC;
+    }
+    File f = LittleFS.open(timePath, "r");
+    size_t n = f ? f.read((uint8_t*) &a, sizeof(a)) : 0;
+    f.close();
+    elapsedMs = millis();
+
+    if (n == sizeof(a) && a.magic == TIME_ANCHOR_MAGIC && a.checksum == checksum(&a, offsetof(timeAnchor, checksum))) {
+        return TIME_SOURCE_FLASH;
+    }
+    return TIME_SOURCE_NONE;
+}
+
+void restoreClock() {
+    timeAnchor a;
+    uint64_t elapsedMs;
+    timeSource source = loadTimeAnchor(a, elapsedMs);
+
+    if (source == TIME_SOURCE_NONE) {
+        Serial.println("No saved time anchor, waiting for NTP");
+        return;
+    }
+    rtClock.anchorUtcMs = (uint64_t) a.utc * 1000 + a.utcMs + elapsedMs;
+    rtClock.anchorMs = millis();
+    rtClock.driftPpb = clockClampPpb(a.driftPpb);
+    rtClock.source = source;
+
+    logPrintf("Restored time from %s (drift %d ppb)\n",
+        source == TIME_SOURCE_RTC ? "RTC memory" : "flash", rtClock.driftPpb);
+}
+
+void disciplineClock(uint64_t utcMs) {
+    if (clockSync(rtClock, utcMs, millis(), DRIFT_WINDOW_SECS * 1000UL)) {
+        logPrintf("Clock drift %d ppb\n", rtClock.driftPpb);
+    }
+    rtClock.prevUtc = 0; // rebuild the frame on next tick
+}
+
+// reads the disciplined UTC clock once per pass and builds the frame of a new second,
+// returns its local time
+time_t tickClock() {
+    uint64_t utcMs = clockUtcMs();
+    time_t utc = utcMs / 1000;
+
+    if (utc != rtClock.prevUtc) {
+        rtClock.prevUtc = utc;
+
+        clockReanchor(rtClock, utcMs, millis());
+        saveTimeAnchor(utcMs);
+        updateFrame(utc);
+    }
+    return frame.local;
+}
+
+/*** WiFi ***/
+
+bool loadWifiCache() {
+    return ESP.rtcUserMemoryRead(RTC_WIFI_OFFSET, (uint32_t*) &wifiCached, sizeof(wifiCached))
+        && wifiCached.magic == WIFI_CACHE_MAGIC
+        && wifiCached.checksum == checksum(&wifiCached, offsetof(wifiCache, checksum));
+}
+
+void saveWifiCache() {
+    wifiCached.magic = WIFI_CACHE_MAGIC;
+    wifiCached.checksum = checksum(&wifiCached, offsetof(wifiCache, checksum));
+    ESP.rtcUserMemoryWrite(RTC_WIFI_OFFSET, (uint32_t*) &wifiCached, sizeof(wifiCached));
+}
+
+void beginWifi(bool fast) {
+#ifdef WIFI_STATIC_IP
+    WiFi.config(IPAddress(WIFI_STATIC_IP), IPAddress(WIFI_GATEWAY), IPAddress(WIFI_SUBNET), IPAddress(WIFI_DNS));
+#endif
+    if (fast) {
+        logPrintf("Connecting to WiFi [%s] on channel %d\n", _WIFI_SSID, wifiCached.channel);
+        WiFi.begin(_WIFI_SSID, _WIFI_PASS, wifiCached.channel, wifiCached.bssid);
+        wifi.state = WIFI_STATE_FAST;
+    } else {
+        logPrintf("Connecting to WiFi [%s]\n", _WIFI_SSID);
+        WiFi.begin(_WIFI_SSID, _WIFI_PASS);
+        wifi.state = WIFI_STATE_SCAN;
+    }
+    wifi.startMs = millis();
+}
+
+void onWifiConnected() {
+    IPAddress ip = WiFi.localIP();
+    logPrintf("IP => " IP_FORMAT " (%lu ms)\n", IP_ARGS(ip), millis() - wifi.startMs);
+    wifi.state = WIFI_STATE_CONNECTED;
+
+    // bound to any address, the socket outlives reconnects and forced sleep
+    if (!udp.localPort()) {
+        udp.begin(FEATURE_SNTP_SERVER ? NTP_PORT : UDP_PORT);
+        logPrintf("Local port: %d\n", udp.localPort());
+    }
+
+    memcpy(wifiCached.bssid, WiFi.BSSID(), sizeof(wifiCached.bssid));
+    wifiCached.channel = WiFi.channel();
+    saveWifiCache();
+}
+
+// non-blocking; falls back to a full scan when the cached AP does not answer
+void updateWifi() {
+    bool connected = WiFi.status() == WL_CONNECTED;
+
+    switch (wifi.state) {
+        case WIFI_STATE_FAST:
+            if (connected) {
+                onWifiConnected();
+            } else if (millis() - wifi.startMs >= WIFI_FAST_TIMEOUT_MS) {
+                Serial.println("Cached WiFi AP not reachable, scanning");
+                beginWifi(false);
+            }
+            break;
+        case WIFI_STATE_SCAN:
+            if (connected) {
+                onWifiConnected(); // SDK keeps retrying on its own until then
+            }
+            break;
+        case WIFI_STATE_CONNECTED:
+            if (!connected) {
+                Serial.println("WiFi connection lost");
+                wifi.state = WIFI_STATE_SCAN;
+                wifi.startMs = millis();
+            }
+            break;
+        default:
+            // nop
+            break;
+    }
+}
+
+/*** radio ***/
+
+// each loop() pass folds the time since the last one into the 64 bit counters
+void updateUptime() {
+    unsigned long elapsedMs = currMs - uptime.prevMs;
+    uptime.prevMs = currMs;
+    uptime.ms += elapsedMs;
+
+    if (wifi.state == WIFI_STATE_OFF) {
+        radio.offMs += elapsedMs;
+    } else {
+        radio.onMs += elapsedMs;
+    }
+}
+
+#if RADIO_SLEEP == RADIO_SLEEP_FORCED
+void sleepRadio() {
+    logPrintf("Radio off, next sync in %ld s\n", (long) (ntp.nextMs - currMs) / 1000);
+    WiFi.disconnect();
+    WiFi.forceSleepBegin();
+    wifi.state = WIFI_STATE_OFF;
+}
+
+// fast rejoin on the cached BSSID/channel, the sync goes out as soon as it is up
+void wakeRadio() {
+    WiFi.forceSleepWake();
+    WiFi.mode(WIFI_STA);
+    beginWifi(wifiCached.channel != 0);
+    ntp.requested = true;
+    radio.wakeMs = currMs;
+    radio.wakes++;
+}
+
+// off once synced with the next sync far enough out, back on leadMs before it
+void updateRadio() {
+    if (wifi.state == WIFI_STATE_OFF) {
+        if (ntp.requested || (long) (currMs - (ntp.nextMs - radio.leadMs)) >= 0) {
+            wakeRadio();
+        }
+    } else if (wifi.state == WIFI_STATE_CONNECTED && ntp.syncs && !ntp.pending && !ntp.requested
+        && (long) (ntp.nextMs - currMs) >= RADIO_MIN_SLEEP_SECS * 1000L) {
+        sleepRadio();
+    }
+}
+#endif
+
+// without forced sleep the latency counts from when the sync falls due
+void onSyncDue() {
+#if RADIO_SLEEP != RADIO_SLEEP_FORCED
+    if (!radio.wakeMs) {
+        radio.wakeMs = currMs;
+    }
+#endif
+}
+
+void onRadioSynced() {
+    if (!radio.wakeMs) {
+        return; // forced sleep: boot or resync while awake
+    }
+    radio.wakeToSyncMs = currMs - radio.wakeMs;
+    radio.maxWakeToSyncMs = max(radio.maxWakeToSyncMs, radio.wakeToSyncMs);
+#if RADIO_SLEEP == RADIO_SLEEP_FORCED
+    radio.leadMs = min((radio.leadMs + radio.wakeToSyncMs) / 2, RADIO_MIN_SLEEP_SECS * 1000UL); // a slow AP does not stick
+#endif
+    radio.wakeMs = 0;
+
+    logPrintf("Radio on %llu s, off %llu s, %u wakes, wake to sync %u ms (max %u ms)\n",
+        radio.onMs / 1000, radio.offMs / 1000, radio.wakes, radio.wakeToSyncMs, radio.maxWakeToSyncMs);
+}
+
 /*** NTP ***/
 
 void sendNtpPacket(IPAddress &ip) {
@@ -185,39 +701,258 @@ void sendNtpPacket(IPAddress &ip) {
     udp.endPacket();
 }
 
-time_t getNtpTime() {
-    IPAddress ntpServerIp;
+void requestNtpSync() {
+    ntp.requested = true;
+}
 
-    while (udp.parsePacket() > 0) {
-        // discard previously received packets
+void sendNtpRequest() {
+    // resolved once and kept, only a failed exchange clears it; the lookup blocks, bounded
+    if (!ntp.serverIp.isSet() && !WiFi.hostByName(ntpServer, ntp.serverIp, NTP_DNS_TIMEOUT_MS)) {
+        logPrintf("Error: DNS lookup failed for NTP server %s\n", ntpServer);
+        ntp.nextMs = currMs + NTP_RETRY_SECS * 1000UL;
+        return;
     }
+    logPrintf("%s:" IP_FORMAT "\n", ntpServer, IP_ARGS(ntp.serverIp));
+    sendNtpPacket(ntp.serverIp);
+
+    ntp.sentMs = millis();
+    ntp.pending = true;
+    ntp.requested = false;
+}
+
+#if FEATURE_SNTP_SERVER
+void updateSntpTemplate(uint32_t rttMs) {
+    uint8_t refId[4] = {ntp.serverIp[0], ntp.serverIp[1], ntp.serverIp[2], ntp.serverIp[3]};
+    uint8_t stratum = min(packetBuffer[1] + 1, SNTP_STRATUM_UNSYNCED - 1);
+    uint32_t rootDelay = sntpReadWord(packetBuffer + SNTP_ROOT_DELAY) + sntpShortFromMs(rttMs);
+    uint32_t rootDispersion = sntpReadWord(packetBuffer + SNTP_ROOT_DISPERSION) + sntpShortFromMs(rttMs / 2);
+
+    sntpBuildTemplate(sntp.tmpl, stratum, refId, rootDelay, rootDispersion, sntpFromUnixMs(rtClock.anchorUtcMs));
+    sntp.syncedMs = millis();
+    sntp.synced = true;
+}
+
+void serveSntp() {
+    sntpTimestamp t = sntpFromUnixMs(clockUtcMs());
 
-    if (!WiFi.hostByName(ntpServer, ntpServerIp)) {
-        Serial.printf("Error: DNS lookup failed for NTP server %s\n", ntpServer);
-        return 0;
+    if (sntp.synced && millis() - sntp.syncedMs >= SNTP_MAX_AGE_SECS * 1000UL) {
+        Serial.println("Warning: upstream NTP sync too old, serving unsynchronized time");
+        sntpMarkUnsynced(sntp.tmpl);
+        sntp.synced = false;
     }
-    Serial.printf("%s:%s\n", ntpServer, ntpServerIp.toString().c_str());
-    sendNtpPacket(ntpServerIp);
+    sntpReply(sntp.reply, sntp.tmpl, packetBuffer, t, t); // ms clock, receive == transmit
+
+    udp.beginPacket(udp.remoteIP(), udp.remotePort());
+    udp.write(sntp.reply, NTP_PACKET_SIZE);
+    udp.endPacket();
+    sntp.served++;
+}
+#endif
 
-    uint32_t wait = millis();
-    while (millis() - wait < NTP_WAIT_MS) {
-        if (udp.parsePacket() >= NTP_PACKET_SIZE) {
-            udp.read(packetBuffer, NTP_PACKET_SIZE);
+void handleNtpReply() {
+    uint32_t rttMs = millis() - ntp.sentMs;
+    ntp.pending = false;
+
+    uint64_t utcMs;
+
+    if (!sntpReplyTime(packetBuffer, rttMs, &utcMs)) {
+        Serial.println("Error: Invalid NTP reply.");
+        ntp.serverIp = IPAddress();
+        ntp.nextMs = currMs + NTP_RETRY_SECS * 1000UL;
+        return;
+    }
+    disciplineClock(utcMs);
+    tickClock();
+    printTime();
+    ntp.nextMs = currMs + NTP_SYNC_SECS * 1000UL;
+    ntp.syncedMs = currMs;
+    ntp.syncs++;
+    onRadioSynced();
+
+#if FEATURE_SNTP_SERVER
+    updateSntpTemplate(rttMs);
+#endif
+    wifiCached.ntpIp = ntp.serverIp;
+    saveWifiCache();
+}
 
-            uint32_t t = (packetBuffer[40] << 24) | (packetBuffer[41] << 16)
-                       | (packetBuffer[42] << 8)  | (packetBuffer[43]);
-            return t - 2208988800UL + (config.utcOffset * SECS_PER_HOUR);
+// dispatches upstream replies and, in server mode, LAN client requests
+void pollNtpSocket() {
+    for (uint8_t i = 0; i < SNTP_PACKETS_PER_TICK; i++) {
+        int size = udp.parsePacket();
+
+        if (size <= 0) {
+            return;
+        } else if (size < NTP_PACKET_SIZE) {
+            continue; // next parsePacket() drops it
+        }
+        udp.read(packetBuffer, NTP_PACKET_SIZE);
+
+#if FEATURE_SNTP_SERVER
+        if (sntpIsRequest(packetBuffer, size)) {
+            serveSntp();
+            continue;
+        }
+#endif
+        if (ntp.pending && udp.remoteIP() == ntp.serverIp) {
+            handleNtpReply();
         }
     }
-    Serial.println("Error: Failed to get time from NTP server.");
-    return 0;
 }
 
-void resyncNtp() {
-    setTime(getNtpTime());
-    printTime();
+// non-blocking; sends a request when due and polls for its reply
+void updateNtp() {
+    if (ntp.requested || (long) (currMs - ntp.nextMs) >= 0) {
+        onSyncDue();
+    }
+    if (wifi.state != WIFI_STATE_CONNECTED) {
+        return;
+    }
+    pollNtpSocket();
+
+    if (ntp.pending) {
+        if (millis() - ntp.sentMs >= NTP_WAIT_MS) {
+            Serial.println("Error: Failed to get time from NTP server.");
+            ntp.serverIp = IPAddress();
+            ntp.pending = false;
+            ntp.nextMs = currMs + NTP_RETRY_SECS * 1000UL;
+        }
+    } else if (ntp.requested || (long) (currMs - ntp.nextMs) >= 0) {
+        sendNtpRequest();
+    }
+}
+
+/*** heap ***/
+
+void updateHeapMonitor() {
+    if ((currMs - heap.poll.prevMs) < heap.poll.intervalMs) {
+        return;
+    }
+    heap.poll.prevMs = currMs;
+
+    uint32_t free, maxBlock;
+    uint8_t frag;
+    ESP.getHeapStats(&free, &maxBlock, &frag);
+
+    if (free < heap.minFree || maxBlock < heap.minMaxBlock || frag > heap.maxFrag) {
+        heap.minFree = min(heap.minFree, free);
+        heap.minMaxBlock = min(heap.minMaxBlock, maxBlock);
+        heap.maxFrag = max(heap.maxFrag, frag);
+        logPrintf("Heap water mark: free %u, max block %u, fragmentation %u%%\n",
+            heap.minFree, heap.minMaxBlock, heap.maxFrag);
+    }
+}
+
+/*** HTTP ***/
+
+#if FEATURE_HTTP
+const char* timeSourceNames[] = {"none", "flash", "rtc", "ntp"};
+const char* radioSleepNames[] = {"none", "modem", "forced"};
+
+void httpClientOut::write(const uint8_t* p, size_t size) {
+    http.client.write(p, size);
 }
 
+void serveStatus() {
+    httpClientOut out;
+    IPAddress ip = WiFi.localIP();
+    char local[DISPLAY_BUFFER_SIZE];
+    formatClock(local, DISPLAY_BUFFER_SIZE, frame);
+
+    apiStatus s = {
+        frame.utc, local, tzName(zone), timeSourceNames[rtClock.source], rtClock.driftPpb,
+        ntpServer, ntp.syncs, ntp.syncs ? (int32_t) ((currMs - ntp.syncedMs) / 1000) : -1,
+        {IP_ARGS(ip)}, WiFi.RSSI(), WiFi.channel(),
+        radioSleepNames[RADIO_SLEEP], RADIO_SLEEP == RADIO_SLEEP_MODEM ? RADIO_LISTEN_INTERVAL : 0,
+        radio.onMs / 1000, radio.offMs / 1000, radio.wakes, radio.wakeToSyncMs, radio.maxWakeToSyncMs,
+        ESP.getFreeHeap(), heap.minFree, heap.minMaxBlock, heap.maxFrag, uptime.ms / 1000,
+    };
+    apiServeStatus(out, httpBuffer, HTTP_BUFFER_SIZE, configBuffer, s, config);
+}
+
+void serveConfig() {
+    httpClientOut out;
+    apiServeConfig(out, httpBuffer, HTTP_BUFFER_SIZE, configBuffer, config);
+}
+
+// body is in configBuffer, applied only as a whole and only when valid
+void applyConfig() {
+    httpClientOut out;
+    const char* err = parseConfig(configBuffer, configIn) ? "invalid JSON" : editConfig(editedConfig, config, configIn);
+
+    if (err) {
+        httpError(out, httpBuffer, HTTP_BUFFER_SIZE, 400, err);
+        return;
+    }
+    config = editedConfig;
+    compileZone();
+    updateLabels();
+    updateFrame(frame.utc);
+#if FEATURE_LIFE_PAGE
+    profileIdx %= config.profileCount;
+#endif
+    requestSaveConfig();
+    Serial.println("Config updated over HTTP");
+    serveConfig();
+}
+
+void respondHttp(httpParse result) {
+    httpClientOut out;
+    int code;
+    const char* message;
+
+    switch (apiResolve(result, http.request, &code, &message)) {
+        case API_STATUS:
+            serveStatus();
+            break;
+        case API_CONFIG:
+            serveConfig();
+            break;
+        case API_CONFIG_EDIT:
+            applyConfig();
+            break;
+        case API_ERROR:
+            httpError(out, httpBuffer, HTTP_BUFFER_SIZE, code, message);
+            break;
+    }
+}
+
+// accepts, reads at most HTTP_BYTES_PER_TICK and responds once the request is complete
+void updateHttp() {
+    if (!http.active) {
+        if (wifi.state != WIFI_STATE_CONNECTED) {
+            return;
+        }
+        http.client = httpServer.accept();
+
+        if (!http.client) {
+            return;
+        }
+        httpBegin(http.request);
+        http.startMs = currMs;
+        http.active = true;
+    }
+    httpParse result = HTTP_PARSE_MORE;
+
+    for (uint16_t i = 0; i < HTTP_BYTES_PER_TICK && result == HTTP_PARSE_MORE && http.client.available(); i++) {
+        result = httpFeed(http.request, http.client.read(), configBuffer, CONFIG_BUFFER_SIZE);
+    }
+    if (result == HTTP_PARSE_MORE) {
+        if (http.client.connected() && (currMs - http.startMs) < HTTP_TIMEOUT_MS) {
+            return;
+        }
+        if (http.client.connected()) {
+            httpClientOut out;
+            httpError(out, httpBuffer, HTTP_BUFFER_SIZE, 408, "timeout");
+        }
+    } else {
+        respondHttp(result);
+    }
+    http.client.stop();
+    http.active = false;
+}
+#endif
+
 /*** display ***/
 
 void resetDisplay() {
@@ -227,7 +962,7 @@ void resetDisplay() {
     display.setTextSize(WHITE);
 }
 
-void drawCenteredText(String text, bool horizontal, bool vertical) {
+void drawCenteredText(const char* text, bool horizontal, bool vertical) {
     int16_t x, y;
     uint16_t w, h;
 
@@ -240,11 +975,11 @@ void drawCenteredText(String text, bool horizontal, bool vertical) {
 }
 
 void drawTime() {
-    memset(displayBuffer, 0, DISPLAY_BUFFER_SIZE);
-    sprintf(displayBuffer, clockFormat, year(), month(), day(), hour(), minute(), second());
+    formatClock(displayBuffer, DISPLAY_BUFFER_SIZE, frame);
     drawCenteredText(displayBuffer, true, true);
 }
 
+#if FEATURE_HOURGLASS
 void drawHourglassAnimation() {
     int16_t x = DISPLAY_WIDTH - HOURGLASS_WIDTH - DISPLAY_PAD;
     int16_t y = (DISPLAY_HEIGHT / 2) - (HOURGLASS_HEIGHT / 2);
@@ -255,31 +990,36 @@ void drawHourglassAnimation() {
         hourglassIdx = 0;
     }
 }
-
-void drawTimeRemaining(time_t total, time_t remaining) {
-    double p, h;
-    getTimeRemaining(total, remaining, &p, &h);
-
-    display.setCursor(DISPLAY_PAD, 30);
-    display.printf(percentLeftFormat, p);
-    display.setCursor(DISPLAY_PAD, 54);
-    display.printf(hoursLeftFormat, h);
+#else
+void drawHourglassAnimation() {}
+#endif
+
+void drawTimeRemaining(const countdown& c, time_t remaining) {
+    formatPercentLeft(displayBuffer, DISPLAY_BUFFER_SIZE, c, remaining);
+    display.setCursor(DISPLAY_PAD, PERCENT_LINE_Y);
+    display.print(displayBuffer);
+
+    formatHoursLeft(displayBuffer, DISPLAY_BUFFER_SIZE, remaining);
+    display.setCursor(DISPLAY_PAD, HOURS_LINE_Y);
+    display.print(displayBuffer);
 }
 
+#if FEATURE_YEAR_PAGE
 void drawYearProgressPage() {
     drawCenteredText("Year Remaining", true, false);
     drawHourglassAnimation();
-
-    time_t start = CalendarYrToTm(year(now())) * UNIX_SECS_PER_YEAR; // 01/01/2023
-    time_t end = start + UNIX_SECS_PER_YEAR;                         // 01/01/2024
-
-    drawTimeRemaining(end - start, end - now());
+    drawTimeRemaining(frame.yearSpan, frame.yearRemaining);
 }
+#endif
 
+#if FEATURE_LIFE_PAGE
 void drawLifeProgressPage() {
-    drawCenteredText("Life Remaining", true, false);
+    const profile& p = config.profiles[profileIdx];
+
+    display.setCursor(labels[profileIdx].x, 0);
+    display.println(labels[profileIdx].text);
     drawHourglassAnimation();
-    drawTimeRemaining(config.death - config.birth, config.death - now());
+    drawTimeRemaining(p.span, frame.remaining[profileIdx]);
 }
 
 void drawDateEditLines() {
@@ -294,11 +1034,13 @@ void drawDateEditLines() {
             display.drawLine(82, EDIT_LINE_Y, 90, EDIT_LINE_Y, WHITE); // day
             break;
         default:
-            Serial.printf("Warning: date edit index reached %d\n", editIdx);
+            logPrintf("Warning: date edit index reached %d\n", editIdx);
             break;
     }
 }
 
+#endif
+
 void drawUtcPage(bool edit) {
     if (edit) {
         drawCenteredText("Set UTC Offset", true, false);
@@ -307,72 +1049,110 @@ void drawUtcPage(bool edit) {
         drawCenteredText("UTC Offset", true, false);
     }
     memset(displayBuffer, 0, DISPLAY_BUFFER_SIZE);
-    sprintf(displayBuffer, "% 02.2f", config.utcOffset);
+#if FEATURE_FLOAT_PRINTF
+    sprintf(displayBuffer, "% 02.2f", zone.offset / (1.0f * PAGE_SECS_PER_HOUR));
+#else
+    displayBuffer[0] = ' ';
+    formatRatio(displayBuffer + (zone.offset >= 0), zone.offset, PAGE_SECS_PER_HOUR, 2);
+#endif
     drawCenteredText(displayBuffer, true, true);
+
+    if (zone.hasDst) {
+        display.setCursor(0, HOURS_LINE_Y);
+        drawCenteredText(tzName(zone), true, false);
+    }
 }
 
+#if FEATURE_LIFE_PAGE
+// first profile is the owner's life, the others are named deadlines
 void drawBirthPage(bool edit) {
+    const profile& p = config.profiles[profileIdx];
+
     if (edit) {
         drawDateEditLines();
-        drawCenteredText("Set Birth Date", true, false);
+    }
+    if (profileIdx == 0) {
+        drawCenteredText(edit ? "Set Birth Date" : "Birth Date", true, false);
     } else {
-        drawCenteredText("Birth Date", true, false);
+        snprintf(displayBuffer, DISPLAY_BUFFER_SIZE, "%s%s Start", edit ? "Set " : "", p.name);
+        drawCenteredText(displayBuffer, true, false);
     }
-    memset(displayBuffer, 0, DISPLAY_BUFFER_SIZE);
-    unixTimeToDate(config.birth, displayBuffer);
+    formatDate(displayBuffer, DISPLAY_BUFFER_SIZE, p.span.start);
     drawCenteredText(displayBuffer, true, true);
 }
 
 void drawDeathPage(bool edit) {
+    const profile& p = config.profiles[profileIdx];
+
     if (edit) {
         drawDateEditLines();
-        drawCenteredText("Set Estimated", true, false);
-        display.setCursor(0, display.getCursorY() + 1);
-        drawCenteredText("Death Date", true, false);
+    }
+    if (profileIdx > 0) {
+        snprintf(displayBuffer, DISPLAY_BUFFER_SIZE, "%s%s End", edit ? "Set " : "", p.name);
+        drawCenteredText(displayBuffer, true, false);
     } else {
-        drawCenteredText("Estimated", true, false);
+#if DISPLAY_HEIGHT >= 64
+        drawCenteredText(edit ? "Set Estimated" : "Estimated", true, false);
         display.setCursor(0, display.getCursorY() + 1);
         drawCenteredText("Death Date", true, false);
+#else
+        drawCenteredText(edit ? "Set Death Date" : "Death Date", true, false); // one title line fits
+#endif
     }
-    memset(displayBuffer, 0, DISPLAY_BUFFER_SIZE);
-    unixTimeToDate(config.death, displayBuffer);
+    formatDate(displayBuffer, DISPLAY_BUFFER_SIZE, p.span.end);
     drawCenteredText(displayBuffer, true, true);
 }
 
+#endif
+
+void drawWaitPage() {
+    drawCenteredText(wifi.state == WIFI_STATE_CONNECTED ? "Waiting for NTP" : "Connecting to WiFi", true, true);
+}
+
 void drawPage() {
     resetDisplay();
 
+    if (currState < STATE_SHOW_UTC && rtClock.source == TIME_SOURCE_NONE) {
+        drawWaitPage();
+        display.display();
+        return;
+    }
+
     switch (currState) {
         case STATE_IDLE_TIME:
             drawTime();
             break;
+#if FEATURE_YEAR_PAGE
         case STATE_IDLE_YEAR:
             drawYearProgressPage();
             break;
+#endif
+#if FEATURE_LIFE_PAGE
         case STATE_IDLE_LIFE:
             drawLifeProgressPage();
             break;
-        case STATE_SHOW_UTC:
-            drawUtcPage(false);
-            break;
         case STATE_SHOW_BIRTH:
             drawBirthPage(false);
             break;
         case STATE_SHOW_DEATH:
             drawDeathPage(false);
             break;
-        case STATE_SHOW_NTP:
-            drawCenteredText("Force NTP Resync", true, true);
-            break;
-        case STATE_SET_UTC:
-            drawUtcPage(true);
-            break;
         case STATE_SET_BIRTH:
             drawBirthPage(true);
             break;
         case STATE_SET_DEATH:
             drawDeathPage(true);
             break;
+#endif
+        case STATE_SHOW_UTC:
+            drawUtcPage(false);
+            break;
+        case STATE_SHOW_NTP:
+            drawCenteredText("Force NTP Resync", true, true);
+            break;
+        case STATE_SET_UTC:
+            drawUtcPage(true);
+            break;
     }
     display.display();
 }
@@ -402,32 +1182,61 @@ void scrollPage() {
 }
 
 void editUtc() {
-    config.utcOffset += (UTC_STEP * encoder.dir); // 15 minute step
+    if (config.tz[0]) {
+        // manual offset replaces the TZ rule, continue from the active offset
+        config.utcOffset = zone.offset / (1.0f * PAGE_SECS_PER_HOUR);
+        config.tz[0] = '\0';
+    }
+    float offset = config.utcOffset + UTC_STEP * encoder.dir; // 15 minute step
 
-    if (config.utcOffset < utcRange.fmin) {
-        config.utcOffset = utcRange.fmin;
-    } else if (config.utcOffset > utcRange.fmax) {
-        config.utcOffset = utcRange.fmax;
+    if (validUtcOffset(offset)) {
+        config.utcOffset = offset;
     }
+    compileZone();
+    updateFrame(frame.utc);
 }
 
+// see stepDate() for the calendar steps
 void editDate(time_t& t) {
-    switch (editIdx) {
-        case 0:
-            t += UNIX_SECS_PER_YEAR * encoder.dir;
-            break;
-        case 1:
-            t += UNIX_SECS_PER_MONTH * encoder.dir;
-            break;
-        case 2:
-            t += UNIX_SECS_PER_DAY * encoder.dir;
-            break;
-        default:
-            Serial.printf("Warning: date edit index reached %d\n", editIdx);
-            break;
+    if (editIdx > 2) {
+        logPrintf("Warning: date edit index reached %d\n", editIdx);
+        return;
+    }
+    t = stepDate(t, editIdx, encoder.dir);
+}
+
+#if FEATURE_LIFE_PAGE
+// a step that would put the end at or before the start is dropped
+void editProfileDate(profile& p, bool start) {
+    time_t t = start ? p.span.start : p.span.end;
+    editDate(t);
+
+    if (start && validSpan(t, p.span.end)) {
+        p.span.start = t;
+    } else if (!start && validSpan(p.span.start, t)) {
+        p.span.end = t;
     }
+    updateCountdown(p.span);
+    updateFrame(frame.utc);
 }
 
+// birth/death pages edit the profile last shown on the life page
+void nextProfile() {
+    profileIdx = (profileIdx + 1) % config.profileCount;
+    profileRotation.prevMs = currMs;
+}
+
+void rotateProfiles() {
+    if (currState != STATE_IDLE_LIFE || config.profileCount < 2 || PROFILE_ROTATE_SECS == 0) {
+        profileRotation.prevMs = currMs; // full interval once the page comes up
+        return;
+    }
+    if ((currMs - profileRotation.prevMs) >= profileRotation.intervalMs) {
+        nextProfile();
+    }
+}
+#endif
+
 void handleEncoderMove() {
     readEncoderDirection();
 
@@ -435,12 +1244,14 @@ void handleEncoderMove() {
         case STATE_SET_UTC:
             editUtc();
             break;
+#if FEATURE_LIFE_PAGE
         case STATE_SET_BIRTH:
-            editDate(config.birth);
+            editProfileDate(config.profiles[profileIdx], true);
             break;
         case STATE_SET_DEATH:
-            editDate(config.death);
+            editProfileDate(config.profiles[profileIdx], false);
             break;
+#endif
         default:
             scrollPage();
             break;
@@ -450,39 +1261,48 @@ void handleEncoderMove() {
 
 void handleEncoderPress() {
     switch (currState) {
+#if FEATURE_LIFE_PAGE
+        case STATE_IDLE_LIFE:
+            nextProfile();
+            drawPage();
+            break;
+#endif
         case STATE_SHOW_UTC:
             currState = STATE_SET_UTC;
             break;
+#if FEATURE_LIFE_PAGE
         case STATE_SHOW_BIRTH:
             currState = STATE_SET_BIRTH;
             break;
         case STATE_SHOW_DEATH:
             currState = STATE_SET_DEATH;
             break;
+#endif
         case STATE_SHOW_NTP:
-            resyncNtp();
+            requestNtpSync();
             currState = STATE_IDLE_TIME;
             drawPage();
             break;
         case STATE_SET_UTC:
             currState = STATE_SHOW_UTC;
-            saveConfig();
-            resyncNtp();
+            requestSaveConfig(); // clock keeps UTC, new offset applies on next tick
             break;
+#if FEATURE_LIFE_PAGE
         case STATE_SET_BIRTH:
             if (++editIdx >= 3) {
                 currState = STATE_SHOW_BIRTH;
-                saveConfig();
+                requestSaveConfig();
                 editIdx = 0;
             }
             break;
         case STATE_SET_DEATH:
             if (++editIdx >= 3) {
                 currState = STATE_SHOW_DEATH;
-                saveConfig();
+                requestSaveConfig();
                 editIdx = 0;
             }
             break;
+#endif
         default:
             // nop
             break;
@@ -516,8 +1336,9 @@ void initSerial() {
     Serial.begin(9600);
     Serial.println();
 
-    for (uint8_t t = 3; t > 0; t--){
-        Serial.printf("WAIT %d...\n", t);
+    // only wait for a monitor to attach on power on, resets resume immediately
+    for (uint8_t t = 3; t > 0 && ESP.getResetInfoPtr()->reason == REASON_DEFAULT_RST; t--){
+        logPrintf("WAIT %d...\n", t);
         Serial.flush();
         delay(500);
     }
@@ -525,8 +1346,11 @@ void initSerial() {
 }
 
 void initDisplay() {
-    if (!display.begin(SSD1306_SWITCHCAPVCC, DISPLAY_I2C_ADDR)) {
-        errorHalt("SSD1306 allocation failed.");
+    Wire.begin(DISPLAY_SDA, DISPLAY_SCL);
+    Wire.setClock(400000);
+
+    if (!display.begin()) {
+        errorHalt("Display not found on I2C.");
     }
     delay(250);
     resetDisplay();
@@ -534,44 +1358,42 @@ void initDisplay() {
 }
 
 void initWifi() {
+    WiFi.persistent(false); // credentials come from secrets.h, skip flash writes
     WiFi.mode(WIFI_STA);
-    WiFi.begin(_WIFI_SSID, _WIFI_PASS);
-
-    Serial.printf("Connecting to WiFi [%s]", _WIFI_SSID);
-    display.setCursor(0, 3);
-    display.printf("Connecting to WiFi\n\n%s\n\n", _WIFI_SSID);
-    display.display();
-
-    while (WiFi.status() != WL_CONNECTED) {
-        delay(1000);
-        Serial.printf(".");
-        display.print(".");
-        display.display();
+    WiFi.setAutoReconnect(true);
+#if RADIO_SLEEP == RADIO_SLEEP_MODEM
+    WiFi.setSleepMode(WIFI_MODEM_SLEEP, RADIO_LISTEN_INTERVAL); // applied on association
+#else
+    WiFi.setSleepMode(RADIO_SLEEP == RADIO_SLEEP_NONE ? WIFI_NONE_SLEEP : WIFI_MODEM_SLEEP);
+#endif
+
+    bool cached = loadWifiCache();
+    if (cached) {
+        ntp.serverIp = wifiCached.ntpIp;
+    } else {
+        memset(&wifiCached, 0, sizeof(wifiCached));
     }
-    Serial.printf("IP => %s\n", WiFi.localIP().toString().c_str());
-    
-    udp.begin(UDP_PORT);
-    Serial.printf("Local port: %d\n", udp.localPort());
-
-    resetDisplay();
-    display.display();
+    beginWifi(cached && wifiCached.channel != 0);
+#if FEATURE_HTTP
+    httpServer.begin(); // listens on any address, also across reconnects
+#endif
 }
 
 void initFs() {
     if (!LittleFS.begin()) {
         errorHalt("Error occurred while mounting LittleFS.");
     }
-    delay(50);
 }
 
 void initConfig() {
     config.utcOffset = UTC_OFFSET_DEFAULT;
-    config.birth = BIRTH_DEFAULT;
-    config.death = DEATH_DEFAULT;
+    strlcpy(config.tz, TZ_DEFAULT, sizeof(config.tz));
+    setProfile(config.profiles[0], PROFILE_NAME_DEFAULT, BIRTH_DEFAULT, DEATH_DEFAULT);
+    config.profileCount = 1;
 
-    if (loadConfig()) {
-        errorHalt("Error occurred while loading config from file system.");
-    }
+    loadConfig(); // a broken file leaves the defaults, the next edit overwrites it
+    compileZone();
+    updateLabels();
 }
 
 void initEncoder() {
@@ -594,37 +1416,52 @@ void initEncoder() {
 void setup() {
     initSerial();
     initDisplay();
-    initWifi();
     initFs();
     initConfig();
     initEncoder();
 
-    // NTP sync
-    setSyncProvider(getNtpTime);
-    setSyncInterval(NTP_SYNC_SECS);
-
-    if (timeStatus() != timeSet) {
-        setTime(getNtpTime());
-    }
-    drawTime();
-
     // init globals
     pageRange.imin = STATE_IDLE_TIME;
     pageRange.imax = STATE_SHOW_NTP;
-    utcRange.fmin = UTC_MIN;
-    utcRange.fmax = UTC_MAX;
+
+    // show last known time right away, WiFi and NTP come up in loop()
+    restoreClock();
+    if (rtClock.source != TIME_SOURCE_NONE) {
+        tickClock();
+    }
+    drawPage();
+    initWifi();
+    requestNtpSync();
+#if FEATURE_SNTP_SERVER
+    sntpMarkUnsynced(sntp.tmpl); // until first upstream sync
+#endif
 
     pinMode(LED_BUILTIN, OUTPUT);
 }
 
 void loop() {
     currMs = millis();
-
-    if (timeStatus() != timeNotSet) {
-        if ((currState < STATE_SHOW_UTC) && now() != prevTimeDisplayed) {
-            prevTimeDisplayed = now();
-            drawPage();
-        }
+    updateUptime();
+    updateWifi();
+    updateNtp();
+#if RADIO_SLEEP == RADIO_SLEEP_FORCED
+    updateRadio();
+#endif
+#if FEATURE_HTTP
+    updateHttp();
+#endif
+    updateConfigSave();
+    updateHeapMonitor();
+#if FEATURE_LIFE_PAGE
+    rotateProfiles();
+#endif
+
+    // until the clock is set, idle pages show connection status once a second
+    time_t t = (rtClock.source != TIME_SOURCE_NONE) ? tickClock() : currMs / 1000;
+
+    if ((currState < STATE_SHOW_UTC) && t != prevTimeDisplayed) {
+        prevTimeDisplayed = t;
+        drawPage();
     }
     if (encoder.moved) {
         handleEncoderMove();